@@ -0,0 +1,84 @@
+#ifndef HIVE_ASYNCSEARCH_H
+#define HIVE_ASYNCSEARCH_H
+
+#include "AI.h"
+#include "TimeManager.h"
+#include <functional>
+#include <mutex>
+
+namespace AI
+{
+	// Runs a search in a background thread so that the caller, such as a render loop, never
+	// blocks on it. The search gets a cancellation token and a progress callback through its
+	// SearchLimits. The latest progress can be read while it runs, the play once it is done.
+	class AsyncSearch
+	{
+		public:
+			typedef std::function<Play(const SearchLimits&)> Search; // must not touch what the caller uses meanwhile
+			AsyncSearch();
+			~AsyncSearch();
+			void start(const Search& search, SearchLimits limits); // not while running()
+			void cancel(); // the search ends soon with its best play so far
+			bool running() const { return active; }; // started and its play not taken yet
+			bool done() const { return active && finished; }; // running() and play() will not block
+			Play play(); // waits for the search and returns its play, running() is false afterwards
+			Progress progress(); // the last report, depth 0 and NOPLAY before the first one
+		private:
+			std::thread worker;
+			std::atomic<bool> cancelled, finished;
+			bool active;
+			Play result;
+			std::mutex progress_mutex;
+			Progress last;
+	};
+
+	AsyncSearch::AsyncSearch() : cancelled(false), finished(false), active(false), result(NOPLAY)
+	{
+		last.depth = 0, last.best_play = NOPLAY, last.nodes = 0, last.ms = 0;
+	}
+
+	AsyncSearch::~AsyncSearch()
+	{
+		if (!active) return;
+		cancel();
+		play();
+	}
+
+	void AsyncSearch::start(const Search& search, SearchLimits limits)
+	{
+		assert(!active);
+		cancelled = finished = false;
+		active = true;
+		last.depth = 0, last.best_play = NOPLAY, last.nodes = 0, last.ms = 0;
+		limits.cancel = &cancelled;
+		limits.progress = [this](const Progress& p) {
+			std::lock_guard<std::mutex> lock(progress_mutex);
+			last = p;
+		};
+		worker = std::thread([this, search, limits]() {
+			result = search(limits);
+			finished = true;
+		});
+	}
+
+	void AsyncSearch::cancel()
+	{
+		cancelled = true;
+	}
+
+	Play AsyncSearch::play()
+	{
+		if (!active) return NOPLAY;
+		worker.join();
+		active = false;
+		return result;
+	}
+
+	Progress AsyncSearch::progress()
+	{
+		std::lock_guard<std::mutex> lock(progress_mutex);
+		return last;
+	}
+}
+
+#endif
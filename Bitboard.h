@@ -0,0 +1,212 @@
+#ifndef HIVE_BITBOARD_H
+#define HIVE_BITBOARD_H
+
+#include "Constants.h"
+
+namespace Hive
+{
+	using std::array;
+
+	const int NCELLS = GSIDE*GSIDE; // cell index = y*GSIDE + x
+	const int BBWORDS = (NCELLS + 63) / 64;
+
+	inline int cell_index(int x, int y) { return y*GSIDE + x; }
+	inline int cell_x(int idx) { return idx % GSIDE; }
+	inline int cell_y(int idx) { return idx / GSIDE; }
+
+	class Bitboard // One bit per cell of the hex grid
+	{
+		public:
+			Bitboard() { w.fill(0); }
+			inline bool test(int idx) const { return (w[idx >> 6] >> (idx & 63)) & 1ULL; }
+			inline void set(int idx) { w[idx >> 6] |= 1ULL << (idx & 63); }
+			inline void reset(int idx) { w[idx >> 6] &= ~(1ULL << (idx & 63)); }
+			inline bool any() const;
+			inline int count() const;
+			inline int first() const; // lowest set index, -1 if empty
+			inline int pop_first(); // removes and returns lowest set index
+			inline int nth(int k) const; // index of the k-th lowest set bit (from 0), -1 if there are fewer
+			inline Bitboard operator|(const Bitboard& b) const;
+			inline Bitboard operator&(const Bitboard& b) const;
+			inline Bitboard operator^(const Bitboard& b) const;
+			inline Bitboard operator~() const;
+			inline Bitboard& operator|=(const Bitboard& b);
+			inline Bitboard& operator&=(const Bitboard& b);
+			inline Bitboard& operator^=(const Bitboard& b);
+			inline bool operator==(const Bitboard& b) const { return w == b.w; }
+			inline bool operator!=(const Bitboard& b) const { return w != b.w; }
+			inline Bitboard shifted(int n) const; // bit i -> bit i+n, n in (-64, 64)
+			array<unsigned long long,BBWORDS> w;
+	};
+
+	// Precomputed tables (see precompute_bitboards):
+	Bitboard BB_FULL; // every cell inside the grid
+	array<array<Bitboard,6>,2> BB_DIR_SRC; // x parity, dir -> cells allowed to shift towards dir
+	array<array<int,6>,2> BB_DIR_DELTA; // x parity, dir -> index delta
+	array<array<short,6>,NCELLS> NEIGHBOUR; // cell, dir -> neighbour cell or -1 if outside
+
+	inline bool Bitboard::any() const
+	{
+		for (int i = 0; i < BBWORDS; ++i) {
+			if (w[i]) return true;
+		}
+		return false;
+	}
+
+	inline int Bitboard::count() const
+	{
+		int cnt = 0;
+		for (int i = 0; i < BBWORDS; ++i) {
+			cnt += __builtin_popcountll(w[i]);
+		}
+		return cnt;
+	}
+
+	inline int Bitboard::first() const
+	{
+		for (int i = 0; i < BBWORDS; ++i) {
+			if (w[i]) return (i << 6) + __builtin_ctzll(w[i]);
+		}
+		return -1;
+	}
+
+	inline int Bitboard::pop_first()
+	{
+		for (int i = 0; i < BBWORDS; ++i) {
+			if (w[i]) {
+				int idx = (i << 6) + __builtin_ctzll(w[i]);
+				w[i] &= w[i] - 1;
+				return idx;
+			}
+		}
+		return -1;
+	}
+
+	inline int Bitboard::nth(int k) const
+	{
+		for (int i = 0; i < BBWORDS; ++i) {
+			int cnt = __builtin_popcountll(w[i]);
+			if (k >= cnt) {
+				k -= cnt;
+				continue;
+			}
+			unsigned long long x = w[i];
+			for (; k > 0; --k) x &= x - 1;
+			return (i << 6) + __builtin_ctzll(x);
+		}
+		return -1;
+	}
+
+	inline Bitboard Bitboard::operator|(const Bitboard& b) const
+	{
+		Bitboard r;
+		for (int i = 0; i < BBWORDS; ++i) r.w[i] = w[i] | b.w[i];
+		return r;
+	}
+
+	inline Bitboard Bitboard::operator&(const Bitboard& b) const
+	{
+		Bitboard r;
+		for (int i = 0; i < BBWORDS; ++i) r.w[i] = w[i] & b.w[i];
+		return r;
+	}
+
+	inline Bitboard Bitboard::operator^(const Bitboard& b) const
+	{
+		Bitboard r;
+		for (int i = 0; i < BBWORDS; ++i) r.w[i] = w[i] ^ b.w[i];
+		return r;
+	}
+
+	inline Bitboard Bitboard::operator~() const
+	{
+		Bitboard r;
+		for (int i = 0; i < BBWORDS; ++i) r.w[i] = ~w[i] & BB_FULL.w[i];
+		return r;
+	}
+
+	inline Bitboard& Bitboard::operator|=(const Bitboard& b)
+	{
+		for (int i = 0; i < BBWORDS; ++i) w[i] |= b.w[i];
+		return *this;
+	}
+
+	inline Bitboard& Bitboard::operator&=(const Bitboard& b)
+	{
+		for (int i = 0; i < BBWORDS; ++i) w[i] &= b.w[i];
+		return *this;
+	}
+
+	inline Bitboard& Bitboard::operator^=(const Bitboard& b)
+	{
+		for (int i = 0; i < BBWORDS; ++i) w[i] ^= b.w[i];
+		return *this;
+	}
+
+	inline Bitboard Bitboard::shifted(int n) const
+	{
+		Bitboard r;
+		if (n > 0) {
+			r.w[0] = w[0] << n;
+			for (int i = 1; i < BBWORDS; ++i) r.w[i] = (w[i] << n) | (w[i-1] >> (64 - n));
+			r.w[BBWORDS-1] &= BB_FULL.w[BBWORDS-1]; // drop bits past the last row
+		}
+		else if (n < 0) {
+			n = -n;
+			for (int i = 0; i < BBWORDS-1; ++i) r.w[i] = (w[i] >> n) | (w[i+1] << (64 - n));
+			r.w[BBWORDS-1] = w[BBWORDS-1] >> n;
+		}
+		else {
+			r = *this;
+		}
+		return r;
+	}
+
+	// Cells of b moved one step towards dir (same dir indexing as Game::dirs).
+	// Even and odd columns are shifted separately because of the column offset.
+	inline Bitboard shift_dir(const Bitboard& b, int dir)
+	{
+		return (b & BB_DIR_SRC[0][dir]).shifted(BB_DIR_DELTA[0][dir])
+			| (b & BB_DIR_SRC[1][dir]).shifted(BB_DIR_DELTA[1][dir]);
+	}
+
+	// Every cell adjacent to some cell of b (b itself not included unless adjacent).
+	inline Bitboard neighbours_of(const Bitboard& b)
+	{
+		Bitboard r;
+		for (int dir = 0; dir < 6; ++dir) r |= shift_dir(b, dir);
+		return r;
+	}
+
+	void precompute_bitboards()
+	{
+		const int DX[2][6] = {{ 0, +1, +1, 0, -1, -1 }, { 0, +1, +1, 0, -1, -1 }};
+		const int DY[2][6] = {{ -1, 0, +1, +1, +1, 0 }, { -1, -1, 0, +1, 0, -1 }};
+
+		for (int idx = 0; idx < NCELLS; ++idx) BB_FULL.set(idx);
+
+		for (int parity = 0; parity < 2; ++parity) {
+			for (int dir = 0; dir < 6; ++dir) {
+				BB_DIR_DELTA[parity][dir] = DY[parity][dir] * GSIDE + DX[parity][dir];
+				BB_DIR_SRC[parity][dir] = Bitboard();
+			}
+		}
+
+		for (int y = 0; y < GSIDE; ++y) {
+			for (int x = 0; x < GSIDE; ++x) {
+				int idx = cell_index(x, y);
+				for (int dir = 0; dir < 6; ++dir) {
+					int nx = x + DX[x%2][dir];
+					int ny = y + DY[x%2][dir];
+					// Vertical overflow falls off the board by itself, horizontal would wrap:
+					if (nx >= 0 && nx < GSIDE) BB_DIR_SRC[x%2][dir].set(idx);
+					bool inside = nx >= 0 && nx < GSIDE && ny >= 0 && ny < GSIDE;
+					NEIGHBOUR[idx][dir] = inside ? cell_index(nx, ny) : -1;
+				}
+			}
+		}
+	}
+
+}
+
+#endif
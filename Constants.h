@@ -1,11 +1,11 @@
+#ifndef HIVE_CONSTANTS_H
+#define HIVE_CONSTANTS_H
+
 #pragma GCC optimize("Ofast","unroll-loops","omit-frame-pointer","inline") // Optimization flags
 #pragma GCC option("arch=native","tune=native","no-zero-upper") // Enable AVX
 #pragma GCC target("avx")  // Enable AVX
 // #include <x86intrin.h> // AVX/SSE Extensions
 
-#ifndef HIVE_CONSTANTS_H
-#define HIVE_CONSTANTS_H
-
 #include <iostream>
 #include <cassert>
 #include <vector>
@@ -34,18 +34,20 @@ namespace Hive
 	const long long GSIDE = 30; // Grid side size
 	// const int MAXDEPTH = 4;
 	const int TLE = 5000; // milliseconds max time for ia turn
-	const int TT_size = 16384;
+	const bool PONDER = true; // the ia also thinks on the player's time
+	const int TT_MB = 64; // transposition table size in MB
+	const int MCTS_MB = 256; // MCTS arenas size in MB
 	const Color player_color = Color::White;
 	const Color ia_color = Color::Black;
 	const std::array<Color,2> COLORS = {Color::Black, Color::White};
 	const std::array<Piece,NPIECETYPES> PIECES = { Ant, Bee, Beetle, Grasshopper, Spider };
-	const std::array<int,NPIECETYPES> PIECEVAL = { 3, 5, 2, 2, 1 };
 	long long pow10[19];
-	unsigned long long powAmodB[GSIDE*GSIDE*GSIDE];
-	const unsigned long long A = 2999999929;
-	const unsigned long long B = 3333323333;
+	unsigned long long ZOBRIST[2][2][NPIECETYPES][GSIDE*GSIDE]; // layer, color, piece, cell relative to the hash anchor
+	unsigned long long ZOBRIST_SIDE; // xor-ed in when White is to move
 	const long double C = 1.4142135623730951; // sqrt(2)
 
+	void precompute_bitboards(); // Bitboard.h
+
 	void precompute_global_variables()
 	{
 		pow10[0] = 1;
@@ -53,10 +55,25 @@ namespace Hive
 			pow10[i] = pow10[i-1] * 10;
 		}
 
-		powAmodB[0] = 1;
-		for (int i = 1; i < GSIDE*GSIDE*GSIDE; ++i) {
-			powAmodB[i] = powAmodB[i-1] * A % B;
+		unsigned long long seed = 0x9E3779B97F4A7C15ULL; // fixed seed, keys must not change between runs
+		auto splitmix64 = [&seed]() {
+			unsigned long long z = (seed += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		};
+		for (int layer = 0; layer < 2; ++layer) {
+			for (int color = 0; color < 2; ++color) {
+				for (int piece = 0; piece < NPIECETYPES; ++piece) {
+					for (int i = 0; i < GSIDE*GSIDE; ++i) {
+						ZOBRIST[layer][color][piece][i] = splitmix64();
+					}
+				}
+			}
 		}
+		ZOBRIST_SIDE = splitmix64();
+
+		precompute_bitboards();
 	}
 }
 
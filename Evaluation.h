@@ -0,0 +1,123 @@
+#ifndef HIVE_EVALUATION_H
+#define HIVE_EVALUATION_H
+
+#include "AI.h"
+#include <fstream>
+#include <sstream>
+
+namespace AI
+{
+	// The evaluation is linear: the weights times features counted for one side minus the same
+	// for the other. Bee liberties, Beetles on the enemy Bee and reserves read state that
+	// Game::spawn / destroy / make_move keep up to date (the neighbour count of each cell,
+	// bitboards, pieces left), so they cost a few lookups. Pinned pieces need the articulation
+	// DFS of pinned() and mobility a move generation per piece, so those are only computed when
+	// one of their weights is not zero. The default weights are the old hand-made evaluation and
+	// leave them out, a tuned weights file can bring them in.
+	enum Feature {
+		BeeLiberties, // empty cells around the Bee, before it is placed 5, the most a placed Bee has
+		PinnedPieces, // pieces that would split the hive if they moved
+		AntMoves, BeeMoves, BeetleMoves, GrasshopperMoves, SpiderMoves, // plays of the pieces of each type
+		BeetlesOnBee, // Beetles on top of the enemy Bee
+		ReserveAnts, ReserveBees, ReserveBeetles, ReserveGrasshoppers, ReserveSpiders, // not placed yet
+		NFEATURES
+	};
+
+	const array<string,NFEATURES> FEATURE_NAMES = {{
+		"BeeLiberties", "PinnedPieces",
+		"AntMoves", "BeeMoves", "BeetleMoves", "GrasshopperMoves", "SpiderMoves",
+		"BeetlesOnBee",
+		"ReserveAnts", "ReserveBees", "ReserveBeetles", "ReserveGrasshoppers", "ReserveSpiders",
+	}};
+
+	typedef array<ll,NFEATURES> Weights;
+	typedef array<int,NFEATURES> Features;
+
+	const Weights DEFAULT_WEIGHTS = {{ // the old evaluation: 100 per Bee neighbour, 10 * piece value on the board
+		100, 0,
+		0, 0, 0, 0, 0,
+		0,
+		-30, -50, -20, -20, -10,
+	}};
+
+	Weights weights = DEFAULT_WEIGHTS;
+
+	// pinned, mobility: whether to count PinnedPieces and the *Moves features, they stay 0 otherwise
+	void add_features(Game& game, Color color, int sign, bool pinned, bool mobility, Features& f)
+	{
+		Color enemy = (Color)!color;
+		f[BeeLiberties] += sign * (game.bee_spawned[color] ? 6 - game.surrounding_cnt(game.positions[color][Piece::Bee][0]) : 5);
+
+		if (pinned) { // layer 0 pieces not covered by a Beetle
+			f[PinnedPieces] += sign * (game.color_bb[0][color] & ~game.occupied[1] & game.pinned()).count();
+		}
+		if (mobility && game.bee_spawned[color]) {
+			HexList moves;
+			for (Piece piece : PIECES) {
+				for (Hex h : game.positions[color][piece]) {
+					moves.clear();
+					game.valid_moves(h, moves);
+					for (Hex p : moves) { // as gen_plays
+						if (!game.is_outside(p) && game.grid[p.x][p.y][p.layer].piece == Piece::NoPiece) f[AntMoves + piece] += sign;
+					}
+				}
+			}
+		}
+
+		if (game.bee_spawned[enemy]) {
+			Hex bee = game.positions[enemy][Piece::Bee][0];
+			if (bee.layer == 0 && game.color_bb[1][color].test(cell_index(bee.x, bee.y))) f[BeetlesOnBee] += sign;
+		}
+
+		for (Piece piece : PIECES) f[ReserveAnts + piece] += sign * game.pieces_left[color][piece];
+	}
+
+	// color's features minus the other side's
+	void features(Game& game, Color color, Features& f, bool pinned = true, bool mobility = true)
+	{
+		f.fill(0);
+		add_features(game, color, 1, pinned, mobility, f);
+		add_features(game, (Color)!color, -1, pinned, mobility, f);
+	}
+
+	ll evaluate(Game& game, Color color, const Weights& w = weights) // from color's point of view
+	{
+		bool mobility = false;
+		for (int i = AntMoves; i <= SpiderMoves; ++i) mobility |= (w[i] != 0);
+		Features f;
+		features(game, color, f, w[PinnedPieces] != 0, mobility);
+		ll score = 0;
+		for (int i = 0; i < NFEATURES; ++i) score += w[i] * f[i];
+		return score;
+	}
+
+	// Weights file: one "name value" per line, # starts a comment. Features it does not
+	// name keep their value. False, with w unchanged, if the file cannot be read or is malformed.
+	bool load_weights(const string& path, Weights& w = weights)
+	{
+		ifstream in(path.c_str());
+		if (!in) return false;
+		Weights loaded = w;
+		for (string line; getline(in, line); ) {
+			line = line.substr(0, line.find('#'));
+			istringstream fields(line);
+			string name;
+			ll value;
+			if (!(fields >> name)) continue; // blank or comment
+			int i = find(FEATURE_NAMES.begin(), FEATURE_NAMES.end(), name) - FEATURE_NAMES.begin();
+			if (i == NFEATURES || !(fields >> value)) return false;
+			loaded[i] = value;
+		}
+		w = loaded;
+		return true;
+	}
+
+	bool save_weights(const string& path, const Weights& w = weights)
+	{
+		ofstream out(path.c_str());
+		for (int i = 0; i < NFEATURES; ++i) out << FEATURE_NAMES[i] << " " << w[i] << endl;
+		return (bool)out;
+	}
+}
+
+#endif
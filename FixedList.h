@@ -0,0 +1,40 @@
+#ifndef HIVE_FIXEDLIST_H
+#define HIVE_FIXEDLIST_H
+
+#include "Constants.h"
+#include <type_traits>
+
+namespace Hive
+{
+
+	// Vector with compile-time capacity and no heap traffic, for trivially copyable T.
+	// Elements are not constructed until pushed, so declaring one on the stack is free.
+	template <typename T, int N>
+	class FixedList
+	{
+		public:
+			FixedList() : n(0) {};
+			inline void push_back(const T& x) { assert(n < N); data()[n++] = x; };
+			inline void pop_back() { --n; };
+			inline void clear() { n = 0; };
+			inline void resize(int _n) { assert(_n <= N); n = _n; };
+			inline int size() const { return n; };
+			inline bool empty() const { return n == 0; };
+			static inline int capacity() { return N; };
+			inline T& operator[](int i) { return data()[i]; };
+			inline const T& operator[](int i) const { return data()[i]; };
+			inline T& back() { return data()[n-1]; };
+			inline T* begin() { return data(); };
+			inline T* end() { return data() + n; };
+			inline const T* begin() const { return data(); };
+			inline const T* end() const { return data() + n; };
+		private:
+			inline T* data() { return reinterpret_cast<T*>(items); };
+			inline const T* data() const { return reinterpret_cast<const T*>(items); };
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type items[N];
+			int n;
+	};
+
+}
+
+#endif
@@ -2,53 +2,94 @@
 	#define HIVE_HIVE_H
 
 	#include "HexGrid.h"
-	#include <queue>
+	#include "Bitboard.h"
+	#include "FixedList.h"
+	#include "Play.h"
 	#include <algorithm>
-	#include <cstring>
 
 	namespace Hive
 	{
 		using std::array;
 		using std::vector;
-		using std::queue;
 		using std::find;
 		using std::max;
 		using std::min;
 
+		const int MAXPIECEMOVES = 6*NPIECES; // >= empty cells around the hive
+		const int MAXPERTYPE = 3; // Ants and Grasshoppers
+		typedef FixedList<Hex,MAXPIECEMOVES> HexList;
+
+		struct UndoRecord { // everything make_move changes that is not cheap to recompute
+			Play play;
+			Color color;
+			int hash_anchor;
+			unsigned long long zobrist;
+			bool pinned_valid;
+			Bitboard pinned_bb;
+		};
+
 		class Game 
 		{
 			public:
+				Game(); // empty board
 				Game(Piece player_first_piece);
+				void valid_moves(Hex p, HexList& moves); // appends to moves
 				vector<Hex> valid_moves(Hex p);
+				Bitboard spawn_cells(Color color) const;
 				vector<Hex> valid_spawns(Color color);
 				inline bool is_locked(Hex p);
+				inline bool is_pinned(Hex p); // moving p would split the hive
+				const Bitboard& pinned(); // articulation points of the hive, cached until the next spawn / destroy
 				inline bool is_outside(Hex p) const; 
 				bool is_accessible(Hex p, Hex p2);
 				bool has_neighbour_with_color(Hex p, Color color);
-				bool has_neighbour(Hex p, bool all_layers = false);
 				bool put_piece(int x, int y, Color color, Piece piece, bool validated = false);
 				bool move_piece(int x, int y, Hex h, int layer = 0, bool validated = false);
 				void spawn(int x, int y, Color color, Piece piece, int layer = 0);
 				void destroy(Hex h);
+				void make_move(Play play, Color color); // play must be valid
+				void unmake_move(); // undoes the last make_move
+				inline bool can_unmake() const { return !undo_stack.empty(); };
 				Color winner();
 				int surrounding_cnt(Hex h);
 				Hex get_hex_with_color(Color color);
 				Hex get_hex_with_any_piece();
-				unsigned long long hash(long long depth);
-				vector<Hex> get_neighbours(Hex h);
-				vector<Hex> get_empty_neighbours(Hex h, bool all_layers = false);
-				array<array<vector<Hex>,NPIECETYPES>,2> positions; // color, position, index
+				unsigned long long hash(Color color) const; // color: side to move
+				array<array<FixedList<Hex,MAXPERTYPE>,NPIECETYPES>,2> positions; // color, position, index
 				array<array<int,NPIECETYPES>,2> pieces_left;
 				array<int,2> total_pieces_left;
 				array<bool,2> bee_spawned;
 				HexGrid grid;
+				array<Bitboard,2> occupied; // layer
+				array<array<Bitboard,2>,2> color_bb; // layer, color
+				array<array<Bitboard,NPIECETYPES>,2> piece_bb; // layer, piece
 			private:
-				vector<Hex> ant_valid_moves(Hex h);
-				vector<Hex> bee_valid_moves(Hex h);
-				vector<Hex> beetle_valid_moves(Hex h);
-				vector<Hex> grasshopper_valid_moves(Hex h);
-				vector<Hex> spider_valid_moves(Hex h);
-				int count_components();
+				inline void place(int x, int y, int layer, Color color, Piece piece);
+				inline void lift(int x, int y, int layer);
+				inline int anchor() const;
+				inline unsigned long long zobrist_key(const Hex& h) const;
+				void update_hash(const Hex& h);
+				void rehash();
+				void ant_valid_moves(Hex h, HexList& v);
+				void bee_valid_moves(Hex h, HexList& v);
+				void beetle_valid_moves(Hex h, HexList& v);
+				void grasshopper_valid_moves(Hex h, HexList& v);
+				void spider_valid_moves(Hex h, HexList& v);
+				int articulation_dfs(int c, int parent, int& timer);
+				Bitboard pinned_bb;
+				bool pinned_valid;
+				array<unsigned char,NCELLS> dfs_num; // 0 = not visited
+				array<short,NPIECES+1> dfs_cells;
+				unsigned long long zobrist; // Zobrist key of the pieces, relative to hash_anchor
+				int hash_anchor; // cell of the lowest row and lowest even column in use
+				array<int,GSIDE> col_cnt, row_cnt; // layer 0 pieces per column / row
+				array<unsigned char,NCELLS> around; // layer 0 pieces around each cell, kept by place / lift
+				unsigned int col_mask, row_mask; // columns / rows with col_cnt / row_cnt > 0
+				array<array<signed char,NCELLS>,2> slot; // layer, cell -> index in positions
+				vector<UndoRecord> undo_stack;
+				void slide_gates(const Bitboard& empty, array<Bitboard,6>& gates) const;
+				Bitboard slide_step(const Bitboard& from, const array<Bitboard,6>& gates, const Bitboard& targets) const;
+				void append_cells(const Bitboard& b, int layer, HexList& v) const;
 				const array<Hex,2> initial_pos = {{
 					Hex(0, GSIDE/2, GSIDE/2-1), // Black
 					Hex(0, GSIDE/2, GSIDE/2), // White
@@ -74,9 +115,17 @@
 
 		};
 
-		Game::Game(Piece player_first_piece)
+		Game::Game()
 		{
-			assert(player_first_piece != Piece::NoPiece);
+			zobrist = 0;
+			hash_anchor = 0;
+			col_cnt.fill(0);
+			row_cnt.fill(0);
+			col_mask = row_mask = 0;
+			around.fill(0);
+			pinned_valid = false;
+			dfs_num.fill(0);
+			undo_stack.reserve(256);
 			for (Color color : {Color::White, Color::Black}) {
 				bee_spawned[color] = false;
 				pieces_left[color][Piece::Ant] = 3;
@@ -86,13 +135,18 @@
 				pieces_left[color][Piece::Spider] = 2;
 				total_pieces_left[color] = NPIECERPERPLAYER;
 			}
+		}
+
+		Game::Game(Piece player_first_piece) : Game()
+		{
+			assert(player_first_piece != Piece::NoPiece);
 			spawn(initial_pos[ia_color].x, initial_pos[ia_color].y, ia_color, Piece::Spider); // TODO: IA
 			spawn(initial_pos[player_color].x, initial_pos[player_color].y, player_color, player_first_piece);
 		}
 
 		inline bool Game::is_locked(Hex p)
 		{
-			return p.layer == 0 && grid[p.x][p.y][1].piece != Piece::NoPiece;
+			return p.layer == 0 && occupied[1].test(cell_index(p.x, p.y));
 		}
 
 		inline bool Game::is_outside(Hex p) const
@@ -102,59 +156,23 @@
 
 		bool Game::is_accessible(Hex p, Hex p2)
 		{
-			int dx = p2.x - p.x;
-			int dy = p2.y - p.y;
-			int index = -1;
-			for (const Hex& dir : dirs[p.x%2]) {
-				++index;
-				if (dir.x == dx && dir.y == dy) break;
-			}
-			Hex p2_l = p + dirs[p.x%2][(index-1+6)%6];
-			Hex p2_r = p + dirs[p.x%2][(index+1)%6];
-			p2_l.layer = p2_r.layer = p2.layer;
-			if (!is_outside(p2_l) && grid[p2_l].piece == Piece::NoPiece) return true;
-			if (!is_outside(p2_r) && grid[p2_r].piece == Piece::NoPiece) return true;
+			int c = cell_index(p.x, p.y);
+			int c2 = cell_index(p2.x, p2.y);
+			int index = 0;
+			while (index < 5 && NEIGHBOUR[c][index] != c2) ++index;
+			int l = NEIGHBOUR[c][(index-1+6)%6];
+			int r = NEIGHBOUR[c][(index+1)%6];
+			const Bitboard& occ = occupied[p2.layer];
+			if (l >= 0 && !occ.test(l)) return true;
+			if (r >= 0 && !occ.test(r)) return true;
 			return false;
 		}
 
 		bool Game::has_neighbour_with_color(Hex p, Color color)
 		{
-			// for (Hex h : get_neighbours(p)) {
-			// 	if (grid[h.x][h.y][0].color == color) {
-			// 		return true;
-			// 	}
-			// }
-			// return false;
-
-			// Optimized: 
-			for (const Hex& dir : dirs[p.x%2]) {
-				Hex h_ = p + dir;
-				Hex h = Hex(0, h_.x, h_.y);
-				if (!is_outside(h)) {
-					if (grid[h].color == color) return true;
-				}
-			}
-			return false;
-		}
-
-		bool Game::has_neighbour(Hex p, bool all_layers)
-		{
-			// for (Hex h : get_neighbours(p)) {
-			// 	if (grid[h.x][h.y][0].piece != Piece::NoPiece || (all_layers && grid[h.x][h.y][1].piece != Piece::NoPiece)) {
-			// 		return true;
-			// 	}
-			// }
-			// return false;
-
-			// Optimized:
-			for (const Hex& dir : dirs[p.x%2]) {
-				Hex h_ = p + dir;
-				Hex h = Hex(0, h_.x, h_.y);
-				if (!is_outside(h)) {
-					if (grid[h.x][h.y][0].piece != Piece::NoPiece || (all_layers && grid[h.x][h.y][1].piece != Piece::NoPiece)) {
-						return true;
-					}
-				}
+			const Bitboard& bb = color_bb[0][color];
+			for (int n : NEIGHBOUR[cell_index(p.x, p.y)]) {
+				if (n >= 0 && bb.test(n)) return true;
 			}
 			return false;
 		}
@@ -170,22 +188,12 @@
 					return false;
 				}
 			}
-				
-			Hex h = Hex(0, color, x, y, piece);
 
 			if (!validated) {
-				bool is_valid = false;
-				for (Hex pos : valid_spawns(color)) {
-					if (pos.x == h.x && pos.y == h.y) {
-						is_valid = true;
-						break;
-					}
-				}
-
-				if (!is_valid) return false;
+				if (!spawn_cells(color).test(cell_index(x, y))) return false;
 			}
 
-			spawn(x, y, color, piece);
+			make_move(play_put(Hex(0, x, y), piece), color);
 			return true;
 		}
 
@@ -200,7 +208,8 @@
 			Hex h = Hex(layer, _h.color, x, y, _h.piece);
 
 			if (!validated) {
-				vector<Hex> vm = valid_moves(_h);
+				HexList vm;
+				valid_moves(_h, vm);
 				bool is_valid = false;
 				for (Hex pos : vm) {
 					if (pos.x == h.x && pos.y == h.y) {
@@ -212,21 +221,57 @@
 				if (!is_valid) return false;
 			}
 
-			destroy(_h); // always destroy first to avoid piece tracking errors
-			spawn(x, y, h.color, h.piece, h.layer);
+			make_move(play_move(_h, h, _h.piece), _h.color);
 
 			return true;
 		}
 
+		inline void Game::place(int x, int y, int layer, Color color, Piece piece)
+		{
+			grid[x][y][layer] = Hex(layer, color, x, y, piece);
+			int c = cell_index(x, y);
+			occupied[layer].set(c);
+			color_bb[layer][color].set(c);
+			piece_bb[layer][piece].set(c);
+			pinned_valid = false;
+			if (layer == 0) {
+				if (col_cnt[x]++ == 0) col_mask |= 1U << x;
+				if (row_cnt[y]++ == 0) row_mask |= 1U << y;
+				for (int n : NEIGHBOUR[c]) {
+					if (n >= 0) ++around[n];
+				}
+			}
+		}
+
+		inline void Game::lift(int x, int y, int layer)
+		{
+			Hex h = grid[x][y][layer];
+			grid[x][y][layer] = Hex(layer, x, y);
+			int c = cell_index(x, y);
+			occupied[layer].reset(c);
+			color_bb[layer][h.color].reset(c);
+			piece_bb[layer][h.piece].reset(c);
+			pinned_valid = false;
+			if (layer == 0) {
+				if (--col_cnt[x] == 0) col_mask &= ~(1U << x);
+				if (--row_cnt[y] == 0) row_mask &= ~(1U << y);
+				for (int n : NEIGHBOUR[c]) {
+					if (n >= 0) --around[n];
+				}
+			}
+		}
+
 		void Game::spawn(int x, int y, Color color, Piece piece, int layer)
 		{
 			assert(!is_outside(Hex(layer,x,y)) && piece != Piece::NoPiece && color != Color::NoColor);
-			grid[x][y][layer] = Hex(layer, color, x, y, piece);
+			place(x, y, layer, color, piece);
 			if (piece == Piece::Bee) bee_spawned[color] = true;
 			assert(pieces_left[color][piece] >= 0);
 			--pieces_left[color][piece];
 			--total_pieces_left[color];
+			slot[layer][cell_index(x, y)] = positions[color][piece].size();
 			positions[color][piece].push_back(grid[x][y][layer]);
+			update_hash(grid[x][y][layer]);
 		}
 
 		void Game::destroy(Hex h)
@@ -235,294 +280,373 @@
 			h = grid[h];
 			if (h.piece == -1) D(h) << std::endl;
 			assert(h.piece != -1);
-			grid[h] = Hex(h.layer, h.x, h.y);
+			lift(h.x, h.y, h.layer);
 			if (h.piece == Piece::Bee) bee_spawned[h.color] = false;
 			++pieces_left[h.color][h.piece];
 			++total_pieces_left[h.color];
-			positions[h.color][h.piece].erase(find(positions[h.color][h.piece].begin(), positions[h.color][h.piece].end(), h));
+			FixedList<Hex,MAXPERTYPE>& list = positions[h.color][h.piece];
+			int idx = slot[h.layer][cell_index(h.x, h.y)];
+			list[idx] = list.back(); // swap with the last one, order does not matter
+			slot[list[idx].layer][cell_index(list[idx].x, list[idx].y)] = idx;
+			list.pop_back();
+			update_hash(h);
 		}
 
-		vector<Hex> Game::valid_spawns(Color color)
+		void Game::make_move(Play play, Color color)
 		{
-			static bool visited[GSIDE][GSIDE];
+			UndoRecord record;
+			record.play = play;
+			record.color = color;
+			record.hash_anchor = hash_anchor;
+			record.zobrist = zobrist;
+			record.pinned_valid = pinned_valid;
+			if (pinned_valid) record.pinned_bb = pinned_bb;
+			undo_stack.push_back(record);
+
+			Hex to = play.h2();
+			if (play.type() == PlayType::Put) {
+				spawn(to.x, to.y, color, play.piece(), 0);
+			}
+			else {
+				// Moved in place: the piece keeps its index in positions
+				Hex from = grid[play.h()];
+				assert(from.piece == play.piece());
+				lift(from.x, from.y, from.layer);
+				place(to.x, to.y, to.layer, from.color, from.piece);
+				int idx = slot[from.layer][cell_index(from.x, from.y)];
+				slot[to.layer][cell_index(to.x, to.y)] = idx;
+				positions[from.color][from.piece][idx] = grid[to];
+				int new_anchor = anchor();
+				if (new_anchor == hash_anchor) {
+					zobrist ^= zobrist_key(from) ^ zobrist_key(grid[to]);
+				}
+				else {
+					hash_anchor = new_anchor;
+					rehash();
+				}
+			}
+		}
 
-			assert(color != Color::NoColor);
+		void Game::unmake_move()
+		{
+			assert(!undo_stack.empty());
+			const UndoRecord& record = undo_stack.back();
+			Play play = record.play;
+			Hex to = play.h2();
+			if (play.type() == PlayType::Put) {
+				Piece piece = play.piece();
+				lift(to.x, to.y, 0);
+				if (piece == Piece::Bee) bee_spawned[record.color] = false;
+				++pieces_left[record.color][piece];
+				++total_pieces_left[record.color];
+				positions[record.color][piece].pop_back(); // spawn appended it
+			}
+			else {
+				Hex from = play.h();
+				Hex h = grid[to];
+				lift(to.x, to.y, to.layer);
+				place(from.x, from.y, from.layer, h.color, h.piece);
+				int idx = slot[to.layer][cell_index(to.x, to.y)];
+				slot[from.layer][cell_index(from.x, from.y)] = idx;
+				positions[h.color][h.piece][idx] = grid[from];
+			}
+			hash_anchor = record.hash_anchor;
+			zobrist = record.zobrist;
+			pinned_valid = record.pinned_valid;
+			if (pinned_valid) pinned_bb = record.pinned_bb;
+			undo_stack.pop_back();
+		}
 
-			memset(visited, 0, sizeof(visited));
-			vector<Hex> vs; // valid spawns
-			queue<Hex> q;
-			q.push(get_hex_with_color(color));
-			while (!q.empty()) {
-				Hex h = q.front();
-				q.pop();
-				for (const Hex& dir : dirs[h.x%2]) {
-					Hex h2 = h + dir;
-					if (!is_outside(h2) && !visited[h2.x][h2.y]) {
-						if (grid[h2.x][h2.y][0].piece == Piece::NoPiece
-							&& !has_neighbour_with_color(h2, (Color)!color)) 
-						{
-							vs.push_back(h2);
-						}
-						visited[h2.x][h2.y] = true;
-						if (grid[h2.x][h2.y][0].piece != Piece::NoPiece)
-						{
-							q.push(h2);
-						}
+		inline int Game::anchor() const
+		{
+			if (row_mask == 0) return 0; // empty board
+			// Even column so that translating the hive keeps the column offsets of dirs
+			return cell_index(__builtin_ctz(col_mask) & ~1, __builtin_ctz(row_mask));
+		}
+
+		inline unsigned long long Game::zobrist_key(const Hex& h) const
+		{
+			return ZOBRIST[h.layer][h.color][h.piece][cell_index(h.x, h.y) - hash_anchor];
+		}
+
+		void Game::update_hash(const Hex& h)
+		{
+			int new_anchor = anchor();
+			if (new_anchor == hash_anchor) {
+				zobrist ^= zobrist_key(h); // toggles h in or out
+			}
+			else { // the hive moved towards / away from the grid origin: keys are relative to the anchor
+				hash_anchor = new_anchor;
+				rehash();
+			}
+		}
+
+		void Game::rehash()
+		{
+			zobrist = 0;
+			for (Color color : COLORS) {
+				for (Piece piece : PIECES) {
+					for (const Hex& h : positions[color][piece]) {
+						zobrist ^= zobrist_key(h);
 					}
 				}
 			}
-			return vs;
 		}
 
-		vector<Hex> Game::valid_moves(Hex p)
+		Bitboard Game::spawn_cells(Color color) const
+		{
+			assert(color != Color::NoColor);
+
+			Bitboard fringe = neighbours_of(occupied[0]) & ~occupied[0];
+			if (!occupied[0].any()) { // first piece of the game goes to the middle of the grid
+				fringe.set(cell_index(GSIDE/2, GSIDE/2));
+				return fringe;
+			}
+			if (total_pieces_left[color] == NPIECERPERPLAYER && total_pieces_left[!color] == NPIECERPERPLAYER-1) {
+				return fringe; // second piece of the game may touch the first one
+			}
+
+			// Empty cells touching the hive but not touching the enemy (a beetle on top owns the stack)
+			Bitboard enemy_top = color_bb[1][!color] | (color_bb[0][!color] & ~occupied[1]);
+			return fringe & ~neighbours_of(enemy_top);
+		}
+
+		vector<Hex> Game::valid_spawns(Color color)
+		{
+			HexList vs; // valid spawns
+			append_cells(spawn_cells(color), 0, vs);
+			return vector<Hex>(vs.begin(), vs.end());
+		}
+
+		void Game::valid_moves(Hex p, HexList& moves)
 		{
 			assert(p.piece != Piece::NoPiece);
 			assert(p.color != Color::NoColor);
-			if (is_locked(p) || !bee_spawned[p.color]) {
-				return vector<Hex>();
+			if (is_locked(p) || !bee_spawned[p.color] || is_pinned(p)) {
+				return;
 			}
 
 			switch(p.piece) {
 				case Ant:
-					return ant_valid_moves(p);
+					ant_valid_moves(p, moves);
+					return;
 				case Bee:
-					return bee_valid_moves(p);
+					bee_valid_moves(p, moves);
+					return;
 				case Beetle:
-					return beetle_valid_moves(p);
+					beetle_valid_moves(p, moves);
+					return;
 				case Grasshopper: 
-					return grasshopper_valid_moves(p);
+					grasshopper_valid_moves(p, moves);
+					return;
 				case Spider:
-					return spider_valid_moves(p);
+					spider_valid_moves(p, moves);
+					return;
 			}
 
-			assert(false);
-			return vector<Hex>(); // Fatal error
+			assert(false); // Fatal error
 		}
 
-		vector<Hex> Game::ant_valid_moves(Hex h0)
+		vector<Hex> Game::valid_moves(Hex p)
 		{
-			static bool visited[GSIDE][GSIDE];
-
-			destroy(h0); // Temporally delete piece
-
-			vector<Hex> v; // rechable hexs
-			v.reserve(32);
-			if (count_components() == 1) {
-				memset(visited, 0, sizeof(visited));
-				queue<Hex> q;
-				q.push(h0);
-				visited[h0.x][h0.y] = true;
-				while (!q.empty()) {
-					Hex h = grid[q.front()];
-					q.pop();
+			HexList moves;
+			valid_moves(p, moves);
+			return vector<Hex>(moves.begin(), moves.end());
+		}
 
-					for (Hex p : get_neighbours(h)) {
-						if (!is_outside(p) && !visited[p.x][p.y]
-							&& is_accessible(h, p) && grid[p].piece == Piece::NoPiece
-							&& has_neighbour(p))
-						{
-							visited[p.x][p.y] = true;
-							v.push_back(p);
-							q.push(p);
-						}
-					}
-				}
+		void Game::slide_gates(const Bitboard& empty, array<Bitboard,6>& gates) const
+		{
+			// gates[dir]: cells with a free side cell to the left or right of dir,
+			// i.e. a piece standing there is not blocked when sliding towards dir
+			for (int dir = 0; dir < 6; ++dir) {
+				gates[dir] = shift_dir(empty, (dir+2)%6) | shift_dir(empty, (dir+4)%6);
 			}
+		}
 
-			spawn(h0.x, h0.y, h0.color, h0.piece); // Restore piece
-			return v;
+		Bitboard Game::slide_step(const Bitboard& from, const array<Bitboard,6>& gates, const Bitboard& targets) const
+		{
+			Bitboard to;
+			for (int dir = 0; dir < 6; ++dir) {
+				to |= shift_dir(from & gates[dir], dir);
+			}
+			return to & targets;
 		}
 
-		vector<Hex> Game::bee_valid_moves(Hex h0)
+		void Game::append_cells(const Bitboard& b, int layer, HexList& v) const
 		{
-			destroy(h0); // Temporally delete piece
+			Bitboard bb = b;
+			for (int c = bb.pop_first(); c >= 0; c = bb.pop_first()) {
+				v.push_back(Hex(layer, cell_x(c), cell_y(c)));
+			}
+		}
 
-			vector<Hex> v; // rechable hexs
-			if (count_components() == 1) {
-				for (Hex p : get_neighbours(h0)) {
-					if (grid[p].piece == Piece::NoPiece && is_accessible(h0, p)
-						&& has_neighbour(p))
-					{
-						v.push_back(p);
-					}
-				}
+		void Game::ant_valid_moves(Hex h0, HexList& v)
+		{
+			int c0 = cell_index(h0.x, h0.y);
+			Bitboard occ = occupied[0]; // hive without the moving piece
+			occ.reset(c0);
+
+			Bitboard empty = ~occ;
+			Bitboard targets = empty & neighbours_of(occ);
+			array<Bitboard,6> gates;
+			slide_gates(empty, gates);
+			Bitboard visited;
+			visited.set(c0);
+			Bitboard frontier = visited;
+			while (frontier.any()) {
+				frontier = slide_step(frontier, gates, targets) & ~visited;
+				visited |= frontier;
 			}
+			visited.reset(c0);
+			append_cells(visited, 0, v);
+		}
 
-			spawn(h0.x, h0.y, h0.color, h0.piece); // Restore piece
-			return v;
+		void Game::bee_valid_moves(Hex h0, HexList& v)
+		{
+			int c0 = cell_index(h0.x, h0.y);
+			Bitboard occ = occupied[0]; // hive without the moving piece
+			occ.reset(c0);
+
+			Bitboard empty = ~occ;
+			array<Bitboard,6> gates;
+			slide_gates(empty, gates);
+			Bitboard from;
+			from.set(c0);
+			append_cells(slide_step(from, gates, empty & neighbours_of(occ)), 0, v);
 		}
 		
-		vector<Hex> Game::beetle_valid_moves(Hex h0)
-		{
-			destroy(h0); // Temporally delete piece
-
-			vector<Hex> v; // rechable hexs
-			if (count_components() == 1) {
-				for (Hex p : get_empty_neighbours(h0, true)) {
-					if (grid[p].piece == Piece::NoPiece 
-						&& (h0.layer == 1 && p.layer == 0 || is_accessible(h0, p))
-						&& has_neighbour(p, true))
-					{
-						v.push_back(p);
-					}
+		void Game::beetle_valid_moves(Hex h0, HexList& v)
+		{
+			int c0 = cell_index(h0.x, h0.y);
+			Bitboard occ = occupied[0]; // hive without the moving piece
+			if (h0.layer == 0) occ.reset(c0);
+
+			for (int n : NEIGHBOUR[c0]) {
+				if (n < 0 || occupied[1].test(n)) continue;
+				Hex p = Hex(occ.test(n) ? 1 : 0, cell_x(n), cell_y(n));
+				bool touches_hive = false;
+				for (int n2 : NEIGHBOUR[n]) {
+					if (n2 >= 0 && occ.test(n2)) touches_hive = true;
+				}
+				if ((h0.layer == 1 && p.layer == 0 || is_accessible(h0, p)) && touches_hive) {
+					v.push_back(p);
 				}
 			}
-
-			spawn(h0.x, h0.y, h0.color, h0.piece, h0.layer); // Restore piece
-			return v;
 		}
 		
-		vector<Hex> Game::grasshopper_valid_moves(Hex h0)
-		{
-			destroy(h0); // Temporally delete piece
-
-			vector<Hex> v; // rechable hexs
-			if (count_components() == 1) {
-				for (int dir_idx = 0; dir_idx < 6; ++dir_idx) {
-					Hex p = h0 + dirs[h0.x%2][dir_idx];
-					if (!is_outside(p) && grid[p].piece != Piece::NoPiece) {
-						while (!is_outside(p) && grid[p].piece != Piece::NoPiece) {
-							p = p + dirs[p.x%2][dir_idx];
-						}
-						if (!is_outside(p) && grid[p].piece == Piece::NoPiece) {
-							v.push_back(p);
-						}
+		void Game::grasshopper_valid_moves(Hex h0, HexList& v)
+		{
+			int c0 = cell_index(h0.x, h0.y);
+			for (int dir_idx = 0; dir_idx < 6; ++dir_idx) {
+				int c = NEIGHBOUR[c0][dir_idx];
+				if (c >= 0 && occupied[0].test(c)) {
+					while (c >= 0 && occupied[0].test(c)) {
+						c = NEIGHBOUR[c][dir_idx];
+					}
+					if (c >= 0) {
+						v.push_back(Hex(0, cell_x(c), cell_y(c)));
 					}
 				}
 			}
-
-			spawn(h0.x, h0.y, h0.color, h0.piece); // Restore piece
-			return v;
 		}
 		
-		vector<Hex> Game::spider_valid_moves(Hex h0)
-		{
-			static int dist[GSIDE][GSIDE];
-
-			destroy(h0); // Temporally delete piece
-
-			vector<Hex> v; // rechable hexs
-			if (count_components() == 1) {
-				for (Hex h_ : get_neighbours(h0)) { // Find BFS origin
-					if (grid[h_].piece == Piece::NoPiece && has_neighbour(h_)) { 
-						queue<Hex> q;
-						for (int y = max(h0.y - 4, 0); y <= min(h0.y + 4, (int)GSIDE-1); ++y) { // initialize rechable points dist
-							for (int x = max(h0.x - 4, 0); x <= min(h0.x + 4, (int)GSIDE-1); ++x) {
-								dist[x][y] = IINF;
-							}
-						}
-						q.push(h_);
-						dist[h0.x][h0.y] = 0;
-						dist[h_.x][h_.y] = 1;
-						while (!q.empty()) {
-							Hex h = q.front();
-							q.pop();
-							for (Hex p : get_neighbours(h)) {
-								if (!is_outside(p) && dist[p.x][p.y] == IINF
-									&& is_accessible(h, p) && grid[p].piece == Piece::NoPiece
-									&& has_neighbour(p))
-								{
-									dist[p.x][p.y] = dist[h.x][h.y] + 1;
-									if (dist[p.x][p.y] == 3) v.push_back(p);
-									if (dist[p.x][p.y] < 3) q.push(p);
-								}
-							}
-						}
-					}
+		void Game::spider_valid_moves(Hex h0, HexList& v)
+		{
+			int c0 = cell_index(h0.x, h0.y);
+			Bitboard occ = occupied[0]; // hive without the moving piece
+			occ.reset(c0);
+
+			Bitboard empty = ~occ;
+			Bitboard targets = empty & neighbours_of(occ);
+			array<Bitboard,6> gates;
+			slide_gates(empty, gates);
+			// Every path of exactly 3 slides that does not come back to a cell it went through,
+			// a shorter path to the same cell does not rule it out
+			Bitboard path, reached;
+			path.set(c0);
+			Bitboard step1 = slide_step(path, gates, targets);
+			for (int c1 = step1.pop_first(); c1 >= 0; c1 = step1.pop_first()) {
+				Bitboard from1;
+				from1.set(c1);
+				path.set(c1);
+				Bitboard step2 = slide_step(from1, gates, targets) & ~path;
+				for (int c2 = step2.pop_first(); c2 >= 0; c2 = step2.pop_first()) {
+					Bitboard from2;
+					from2.set(c2);
+					path.set(c2);
+					reached |= slide_step(from2, gates, targets) & ~path;
+					path.reset(c2);
 				}
+				path.reset(c1);
 			}
-
-			spawn(h0.x, h0.y, h0.color, h0.piece); // Restore piece
-			return v;
+			append_cells(reached, 0, v);
 		}
 
-		Hex Game::get_hex_with_color(Color color)
+		const Bitboard& Game::pinned()
 		{
-			for (Piece piece : PIECES) {
-				for (Hex h : positions[color][piece]) {
-					if (h.layer == 0) return h;
+			if (!pinned_valid) {
+				pinned_bb = Bitboard();
+				int root = occupied[0].first();
+				if (root >= 0) {
+					int timer = 0;
+					articulation_dfs(root, -1, timer);
+					for (int i = 1; i <= timer; ++i) dfs_num[dfs_cells[i]] = 0; // keep dfs_num all zero
 				}
+				pinned_valid = true;
 			}
-			assert(false); // error
+			return pinned_bb;
 		}
 
-		Hex Game::get_hex_with_any_piece()
+		int Game::articulation_dfs(int c, int parent, int& timer)
 		{
-			for (Color color : COLORS) {
-				for (Piece piece : PIECES) {
-					for (Hex h : positions[color][piece]) {
-						if (h.layer == 0) return h;
-					}
+			// Tarjan / Hopcroft: c is an articulation point if some child subtree has no back edge above c
+			int disc = dfs_num[c] = ++timer;
+			dfs_cells[timer] = c;
+			int low = disc;
+			int children = 0;
+			for (int n : NEIGHBOUR[c]) {
+				if (n < 0 || n == parent || !occupied[0].test(n)) continue;
+				if (dfs_num[n]) {
+					low = min(low, (int)dfs_num[n]);
+				}
+				else {
+					int child_low = articulation_dfs(n, c, timer);
+					low = min(low, child_low);
+					++children;
+					if (parent >= 0 && child_low >= disc) pinned_bb.set(c);
 				}
 			}
-			assert(false); // error
+			if (parent < 0 && children > 1) pinned_bb.set(c);
+			return low;
 		}
 
-		vector<Hex> Game::get_neighbours(Hex p)
+		inline bool Game::is_pinned(Hex p)
 		{
-			vector<Hex> v;
-			for (const Hex& dir : dirs[p.x%2]) {
-				Hex h_ = p + dir;
-				Hex h = Hex(0, h_.x, h_.y);
-				if (!is_outside(h)) v.push_back(h);
-			}
-			return v;
+			return p.layer == 0 && pinned().test(cell_index(p.x, p.y));
 		}
 
-		vector<Hex> Game::get_empty_neighbours(Hex p, bool all_layers)
+		Hex Game::get_hex_with_color(Color color)
 		{
-			vector<Hex> v;
-			for (const Hex& dir : dirs[p.x%2]) {
-				Hex h_ = p + dir;
-				for (int layer = 0; layer <= int(all_layers); ++layer) {
-					Hex h = Hex(layer, h_.x, h_.y);
-					if (!is_outside(h) && grid[h].piece == Piece::NoPiece) {
-						v.push_back(h);
-						break;
-					}
+			for (Piece piece : PIECES) {
+				for (Hex h : positions[color][piece]) {
+					if (h.layer == 0) return h;
 				}
 			}
-			return v;
+			assert(false); // error
 		}
 
-		int Game::count_components()
+		Hex Game::get_hex_with_any_piece()
 		{
-			static bool visited[GSIDE][GSIDE];
-
-			memset(visited, 0, sizeof(visited));
-			Hex h0 = get_hex_with_any_piece();
-			queue<Hex> q;
-			for (Hex h_ : get_neighbours(h0)) { // Find BFS origin
-				if (grid[h_].piece != Piece::NoPiece) { 
-					q.push(h_);
-					break;
-				}
-			}
-			while (!q.empty()) {
-				Hex h = q.front();
-				q.pop();
-				for (Hex p : get_neighbours(h)) {
-					if (!is_outside(p) && !visited[p.x][p.y]
-						&& is_accessible(h, p) && grid[p].piece != Piece::NoPiece
-						&& has_neighbour(p))
-					{
-						visited[p.x][p.y] = true;
-						q.push(p);
-					}
-				}
-			}
-
 			for (Color color : COLORS) {
 				for (Piece piece : PIECES) {
 					for (Hex h : positions[color][piece]) {
-						if (!visited[h.x][h.y]) return 2; // optimization: only count 1 || 2 components
+						if (h.layer == 0) return h;
 					}
 				}
 			}
-
-			return 1;
+			assert(false); // error
 		}
-		
+
 		Color Game::winner()
 		{
 			for (Color color : COLORS) {
@@ -535,50 +659,13 @@
 
 		int Game::surrounding_cnt(Hex h)
 		{
-			int cnt = 0;
-			for (Hex p : get_neighbours(h)) {
-				if (grid[p].piece != Piece::NoPiece) ++cnt;
-			}
-			return cnt;
+			return around[cell_index(h.x, h.y)];
 		}
 
-		unsigned long long Game::hash(long long depth)
+		unsigned long long Game::hash(Color color) const
 		{
-			unsigned long long H = 0;
-			
-			long long mx = GSIDE;
-			long long my = GSIDE;
-
-			for (long long layer = 0; layer < 1; ++layer) {
-				for (long long y = 0; y < GSIDE; ++y) {
-					for (long long x = 0; x < GSIDE; ++x) {
-						Hex h = grid[x][y][layer];
-						if (h.piece != Piece::NoPiece) {
-							mx = min(mx, x);
-							my = min(my, y);
-						}
-					}
-				}
-			}
-
-			for (long long layer = 0; layer < 1; ++layer) {
-				for (long long y = 0; y < GSIDE; ++y) {
-					for (long long x = 0; x < GSIDE; ++x) {
-						Hex h = grid[x][y][layer];
-						if (h.piece != Piece::NoPiece) {
-							long long x_ = x - mx;
-							long long y_ = y - my;
-							H += powAmodB[layer*GSIDE*GSIDE+y_*GSIDE+x_] * ((h.piece + 1) * 3 + (h.color + 1)) % B;
-							H %= B;
-						}
-					}
-				}
-			}
-
-			H += powAmodB[GSIDE*GSIDE*GSIDE-1] * depth % B;
-			H %= B;
-
-			return H;
+			// Translation invariant: keys are relative to hash_anchor
+			return zobrist ^ (color == Color::White ? ZOBRIST_SIDE : 0);
 		}
 
 	}
@@ -2,64 +2,280 @@
 #define HIVE_MCTS_H
 
 #include "AI.h"
+#include "Playout.h"
+#include "TimeManager.h"
 #include <chrono>
+#include <thread>
+#include <new>
 
 namespace MCTS
 {
 	using namespace AI;
 	using namespace std;
 
-	clock_t time_;
+	enum NodeState { NotExpanded, Expanding, Expanded };
+
+	const int VIRTUAL_LOSS = 3; // visits a thread adds while descending, so others pick other paths
+	const int MAXAMAF = 256; // plays per side remembered for the AMAF update, deeper ones are ignored
+	const int MOVES_MB = MCTS_MB / 8; // for the plays of the expanded nodes, the rest is for the nodes
+	const int PROGRESS_MS = 100; // between progress reports
+
+	bool root_parallel = false; // one tree per thread merged at the end, instead of one shared tree
+	bool rave = false; // blend all-moves-as-first statistics into UCT
+	ld RAVE_K = 1000; // visits at which UCT and AMAF weigh the same, beta = sqrt(RAVE_K / (3n + RAVE_K))
+	bool progressive_widening = true; // otherwise a node gets a new child on every visit until all plays are tried
+	ld PW_C = 2, PW_ALPHA = 0.5; // a node with n visits has at most max(1, PW_C * n^PW_ALPHA) children
+	bool ponder = false; // search on the opponent's time, see start_pondering
+	ull ponder_hits = 0, ponder_misses = 0;
+	ull playouts = 0; // in the last search
+	ull playouts_per_sec = 0; // of the last search, all threads
+	int reused_visits = 0; // visits the current root inherited from the previous search
 
 	class Node {
 		public:
 			Node();
-			void expand(Game& game);
+			bool expand(Game& game); // false if already expanded or being expanded by another thread
 			Node* select();
-			ll simulate(Game& game, clock_t time0, Color color);
-			void backpropagation(ll win);
+			Color simulate(Game& game, Playout::PlayList* plays = NULL); // plays != NULL gets the plays made
+			void backpropagation(Node* root, Color winner, const Playout::PlayList* simulated = NULL);
+			Node* search(Game& game, const SearchLimits& limits); // no depth limit, nodes are playouts
+			Node* search(Game& game, int time_ms);
 			Node* play_hive(Game& game);
-			void destroy();
-			int visits;
-			ll wins;
-			bool expanded;
-			Color color;
-			PlayInfo play;
-			Node* parent;
-			V<Node*> childs;
+			Node* find_child(Play play) const; // NULL if play was not tried
+			inline Node* children() const; // the newest child, NULL if there are none
+			inline Node* sibling() const; // the next older child of parent, NULL if there are none
+			atomic<int> visits; // includes the virtual losses of the threads below
+			atomic<ll> wins; // playouts won by the side that played play
+			atomic<int> amaf_visits; // playouts through parent where the side to move played play later on, for RAVE
+			atomic<int> amaf_wins; // of those, won by that side
+			atomic<int> state; // NodeState, the plays can be read once Expanded
+			Color color; // side to move
+			Play play;
+			int parent; // arena index, -1 for a root
+			atomic<int> first_child; // arena index of the newest child, -1 if there are none
+			int next; // arena index of the next older sibling, -1 if there are none
+			atomic<int> nchilds; // plays taken to make children so far
+			int first_play; // moves index of the nplays plays, children are made in this order
+			int nplays;
 		private:
-			inline void set_parent(Node* _parent) { parent = _parent; };
-			inline void set_play(PlayInfo _play) { play = _play; };
+			inline void set_parent(int _parent) { parent = _parent; };
+			inline void set_play(Play _play) { play = _play; };
 			inline void set_color(Color _color) { color = _color; };
 			inline ld uct() const;
-			Node* random_child();
+			inline bool can_widen() const;
+			template<int N> void update_amaf(const FixedList<Play,N>& seen, Color winner);
+			Node* add_child();
+			ull work(Game game, TimeManager& budget, bool reports);
+			void merge(Node* other);
+	};
+
+	template<class T> class Arena // Bump allocator for the search trees, freed all at once
+	{
+		public:
+			Arena(size_t mb);
+			~Arena();
+			int alloc(int n); // index of n consecutive new items, -1 if the arena is full
+			inline void reset() { top = 0; }; // frees every tree
+			inline T& operator[](int i) { return items[i]; };
+			inline int index(const T* item) const { return item - items; };
+			inline int size() const { return min(top.load(), capacity); };
+			void swap(Arena& other); // both must have the same capacity
+			const int capacity;
+		private:
+			T* items; // raw memory, constructed on alloc
+			atomic<int> top;
 	};
 
+	template<class T> Arena<T>::Arena(size_t mb) : capacity((mb << 20) / sizeof(T))
+	{
+		items = (T*)operator new(capacity * sizeof(T));
+		top = 0;
+	}
+
+	template<class T> Arena<T>::~Arena()
+	{
+		operator delete(items); // T is trivially destructible
+	}
+
+	template<class T> int Arena<T>::alloc(int n)
+	{
+		if (top.load(memory_order_relaxed) + n > capacity) return -1;
+		int first = top.fetch_add(n);
+		if (first + n > capacity) return -1; // another thread took the rest
+		for (int i = first; i < first + n; ++i) new (&items[i]) T();
+		return first;
+	}
+
+	template<class T> void Arena<T>::swap(Arena& other)
+	{
+		assert(capacity == other.capacity);
+		std::swap(items, other.items);
+		int t = top;
+		top = other.top.load();
+		other.top = t;
+	}
+
+	Arena<Node> arena((MCTS_MB - MOVES_MB) / 2); // shared by all threads
+	Arena<Play> moves(MOVES_MB / 2); // the plays of the expanded nodes of arena
+	Arena<Node> spare((MCTS_MB - MOVES_MB) / 2); // where keep_subtree compacts the tree to keep
+	Arena<Play> spare_moves(MOVES_MB / 2);
+
+	atomic<bool> stop(false); // ends the running search
+	thread ponder_thread;
+	Game* ponder_game = NULL; // searched by ponder_thread, NULL when not pondering
+
+	void stop_pondering()
+	{
+		if (ponder_game == NULL) return;
+		stop = true;
+		ponder_thread.join();
+		stop = false;
+		delete ponder_game;
+		ponder_game = NULL;
+	}
+
+	// Frees every node and returns the root of a new tree, color to move
+	Node* new_tree(Color color)
+	{
+		stop_pondering();
+		arena.reset();
+		moves.reset();
+		reused_visits = 0;
+		Node* root = &arena[arena.alloc(1)];
+		root->color = color;
+		return root;
+	}
+
+	// Makes node the root of the tree, keeping its subtree with its statistics and freeing
+	// every other node. The subtree is copied breadth first into the spare arenas, which then
+	// become the arenas, so pointers into the old tree are no longer valid.
+	Node* keep_subtree(Node* node)
+	{
+		stop_pondering();
+		spare.reset();
+		spare_moves.reset();
+		V<int> from(1, arena.index(node)); // from[i]: index in arena of the node copied to spare[i]
+		spare.alloc(1);
+		for (int i = 0; i < (int)from.size(); ++i) {
+			Node& old = arena[from[i]];
+			Node& copy = spare[i];
+			copy.color = old.color;
+			copy.play = (i == 0 ? NOPLAY : old.play);
+			copy.visits = old.visits.load();
+			copy.wins = old.wins.load();
+			copy.amaf_visits = old.amaf_visits.load();
+			copy.amaf_wins = old.amaf_wins.load();
+			if (old.state != Expanded) continue; // NotExpanded, a search never leaves a node Expanding
+			copy.state = Expanded;
+			copy.first_play = spare_moves.alloc(old.nplays); // never full, the subtree fits in moves
+			copy.nplays = old.nplays;
+			for (int j = 0; j < old.nplays; ++j) spare_moves[copy.first_play + j] = moves[old.first_play + j];
+			copy.nchilds = old.nchilds.load();
+			int last = -1;
+			for (Node* child = old.children(); child != NULL; child = child->sibling()) {
+				int c = spare.alloc(1);
+				spare[c].parent = i;
+				if (last < 0) copy.first_child = c;
+				else spare[last].next = c;
+				last = c;
+				from.push_back(arena.index(child));
+			}
+		}
+		arena.swap(spare);
+		moves.swap(spare_moves);
+		spare.reset();
+		spare_moves.reset();
+		reused_visits = arena[0].visits;
+		return &arena[0];
+	}
+
 	Node::Node()
 	{
 		visits = 0;
 		wins = 0;
-		expanded = false;
-		parent = NULL;
-		childs = V<Node*>();
+		amaf_visits = amaf_wins = 0;
+		state = NotExpanded;
+		parent = -1;
+		first_child = next = -1;
+		nchilds = 0;
+		first_play = nplays = 0;
 		color = Color::NoColor;
-		play = play_info_null();
+		play = NOPLAY;
+	}
+
+	Node* Node::find_child(Play play) const
+	{
+		for (Node* child = children(); child != NULL; child = child->sibling()) {
+			if (child->play == play) return child;
+		}
+		return NULL;
+	}
+
+	inline Node* Node::children() const
+	{
+		int i = first_child.load(memory_order_acquire);
+		return i >= 0 ? &arena[i] : NULL;
+	}
+
+	inline Node* Node::sibling() const
+	{
+		return next >= 0 ? &arena[next] : NULL;
 	}
 
 	inline ld Node::uct() const
 	{
-		if (visits == 0) return INF;
-		return (ld)wins / visits + C * sqrt(log(parent->visits) / visits);
+		int n = visits.load(memory_order_relaxed);
+		if (n == 0) return INF;
+		ld value = (ld)wins.load(memory_order_relaxed) / n;
+		int amaf_n = amaf_visits.load(memory_order_relaxed);
+		if (rave && amaf_n > 0) {
+			ld beta = sqrt(RAVE_K / (3 * n + RAVE_K));
+			value = (1 - beta) * value + beta * amaf_wins.load(memory_order_relaxed) / amaf_n;
+		}
+		return value + C * sqrt(log(arena[parent].visits.load(memory_order_relaxed)) / n);
+	}
+
+	inline bool Node::can_widen() const
+	{
+		int n = nchilds.load(memory_order_relaxed);
+		if (n >= nplays) return false;
+		return !progressive_widening || n < max(1, (int)(PW_C * pow(visits.load(memory_order_relaxed), PW_ALPHA)));
+	}
+
+	// Makes a child for the next untried play, NULL if there is none or the arena is full.
+	// Children are pushed at the front of the list, so readers never see a half-made one.
+	Node* Node::add_child()
+	{
+		int n = nchilds.load(memory_order_relaxed);
+		do {
+			if (n >= nplays) return NULL;
+		} while (!nchilds.compare_exchange_weak(n, n+1));
+		int i = arena.alloc(1);
+		if (i < 0) return NULL; // this node stays without that play
+		Node& child = arena[i];
+		child.set_parent(arena.index(this));
+		child.set_play(moves[first_play + n]);
+		child.set_color((Color)!color);
+		int head = first_child.load(memory_order_relaxed);
+		do {
+			child.next = head;
+		} while (!first_child.compare_exchange_weak(head, i, memory_order_release, memory_order_relaxed));
+		return &child;
 	}
 
+	// A new child if the widening schedule allows one, otherwise the child with the best UCT.
+	// NULL if there are no children.
 	Node* Node::select()
 	{
+		if (can_widen()) {
+			Node* node = add_child();
+			if (node != NULL) return node;
+		}
 		Node* best_node = NULL;
 		ld best_uct = -INF;
-		random_shuffle(childs.begin(), childs.end());
-		for (Node* node : childs) {
+		for (Node* node = children(); node != NULL; node = node->sibling()) {
 			ld node_uct = node->uct();
-			if (node_uct - best_uct > -EPS) { // update if greatest or equal score
+			if (node_uct > best_uct) {
 				best_uct = node_uct;
 				best_node = node;
 			}
@@ -67,248 +283,227 @@ namespace MCTS
 		return best_node;
 	}
 
-	void Node::expand(Game& game)
+	// Stores the plays of the position, the children are made from them by select()
+	bool Node::expand(Game& game)
 	{
-		if (expanded) return;
+		int expected = NotExpanded;
+		if (!state.compare_exchange_strong(expected, Expanding)) return false;
 		// cout << "expand() - "; D(this), D(color), D(parent) << endl;
-		V<PlayInfo> plays = gen_plays(game, color);
-		for (PlayInfo p : plays) {
-			// D(p) << endl;
-			Node* child = new Node();
-			child->set_parent(this);
-			// D(this), D(child) << endl;
-			child->set_play(p);
-			child->set_color((Color)!color);
-			childs.push_back(child);
+		MoveList plays;
+		if (game.winner() == Color::NoColor) gen_plays(game, color, plays); // shuffled, the order children are made in
+		int first = moves.alloc(plays.size());
+		if (first >= 0) { // otherwise the arena is full and this stays a leaf
+			for (int i = 0; i < plays.size(); ++i) moves[first + i] = plays[i];
+			first_play = first;
+			nplays = plays.size();
 		}
-		expanded = true;
+		state.store(Expanded, memory_order_release);
+		return true;
 	}
 
-	// ll Node::simulate(Game& game, clock_t time0, Color _color) // heuristic
-	// {
-	// 	const int depth = 32;
-	// 	assert(depth%2==0); // to ensure _color is the same after iterations
-
-	// 	V<PlayInfo> stack1;
-	// 	V<Color> stack2;
-	// 	stack1.reserve(depth);
-	// 	stack2.reserve(depth);
-	// 	bool end = false;
-	// 	ll win = 0;
-
-	// 	for (int i = 0; !end && i < depth; ++i) {
-	// 		Color winner = game.winner();
-	// 		if (winner != Color::NoColor) {
-	// 			win = (winner == color ? pow10[5] : -pow10[5]);
-	// 			end = true;
-	// 		}
-
-	// 		PlayInfo p = gen_random_play(game, _color);
-
-	// 		if (p.type != PlayType::NoPlay) {
-	// 			do_play(game, p, _color);
-	// 			_color = (Color)!color;
-
-	// 			stack1.push_back(p);
-	// 			stack2.push_back(_color);
-	// 		}
-	// 		else {
-	// 			end = true;
-	// 		}
-	// 	}
-
-	// 	win = get_heuristic_score_for_color(game, _color);
-
-	// 	while (!stack1.empty()) {
-	// 		undo_play(game, stack1.back(), stack2.back());
-	// 		stack1.pop_back();
-	// 		stack2.pop_back();
-	// 	}
-
-	// 	return win;
-	// }
-
-	ll Node::simulate(Game& game, clock_t time0, Color _color) // binary -> win / lose
+	Color Node::simulate(Game& game, Playout::PlayList* plays) // random playout, returns the winner or NoColor
 	{
-		const int depth = 24;
-
-		V<PlayInfo> stack1;
-		V<Color> stack2;
-		stack1.reserve(depth);
-		stack2.reserve(depth);
-		bool end = false;
-		bool win = false;
-
-		for (int i = 0; !end && i < depth; ++i) {
-			Color winner = game.winner();
-			if (winner != Color::NoColor) {
-				win = winner == color;
-				end = true;
-			}
-
-			PlayInfo p = gen_random_play(game, _color);
-
-			if (p.type != PlayType::NoPlay) {
-				do_play(game, p, _color);
-				_color = (Color)!color;
+		return Playout::playout(game, color, plays);
+	}
 
-				stack1.push_back(p);
-				stack2.push_back(_color);
-			}
-			else {
-				end = true;
+	// With simulated, the plays of the playout, also updates the AMAF statistics of the
+	// children of every node on the way up
+	void Node::backpropagation(Node* root, Color winner, const Playout::PlayList* simulated)
+	{
+		array<FixedList<Play,MAXAMAF>,2> seen; // color -> plays of color below the current node
+		if (simulated != NULL) {
+			Color c = color;
+			for (Play p : *simulated) {
+				seen[c].push_back(p);
+				c = (Color)!c;
 			}
 		}
-
-		while (!stack1.empty()) {
-			undo_play(game, stack1.back(), stack2.back());
-			stack1.pop_back();
-			stack2.pop_back();
+		Node* node = this;
+		while (true) {
+			node->visits += (node == root ? 1 : 1 - VIRTUAL_LOSS); // the virtual loss becomes a real visit
+			if (winner == !node->color) ++node->wins;
+			if (simulated != NULL) {
+				node->update_amaf(seen[node->color], winner);
+				if (seen[!node->color].size() < MAXAMAF) seen[!node->color].push_back(node->play);
+			}
+			if (node == root) break;
+			node = &arena[node->parent];
 		}
-
-		return win;
 	}
 
-	// bool Node::simulate(Game& game, clock_t time0, Color _color) // optimized for future search
-	// {
-	// 	V<PlayInfo> stack1;
-	// 	V<Color> stack2;
-	// 	stack1.reserve(64);
-	// 	stack2.reserve(64);
-	// 	bool end = false;
-	// 	bool win = false;
-	// 	Node* node = this;
-
-	// 	for (int i = 0; !end && i < 16; ++i) {
-	// 		node->expand(game);
-
-	// 		Color winner = game.winner();
-	// 		if (winner != Color::NoColor) {
-	// 			win = winner == color;
-	// 			end = true;
-	// 		}
-
-	// 		if (!node->childs.empty()) {
-	// 			int idx = rand_int(0, node->childs.size()-1);
-	// 			Node* child = node->childs[idx];
-	// 			do_play(game, child->play, node->color);
-
-	// 			stack1.push_back(node->play);
-	// 			stack2.push_back(node->color);
-
-	// 			node = child;
-	// 		}
-	// 		else {
-	// 			end = true;
-	// 		}
-	// 	}
-
-	// 	while (!stack1.empty()) {
-	// 		undo_play(game, stack1.back(), stack2.back());
-	// 		stack1.pop_back();
-	// 		stack2.pop_back();
-	// 	}
-
-	// 	return win;
-	// }
-
-	void Node::backpropagation(ll win)
+	template<int N> void Node::update_amaf(const FixedList<Play,N>& seen, Color winner)
 	{
-		Node* node = this;
-		while (node != NULL) {
-			++node->visits;
-			node->wins += win;
-			node = node->parent;
+		for (Node* node = children(); node != NULL; node = node->sibling()) {
+			if (find(seen.begin(), seen.end(), node->play) == seen.end()) continue;
+			++node->amaf_visits;
+			if (winner == color) ++node->amaf_wins;
 		}
 	}
 
-	Node* Node::random_child()
+	// One search thread: selection, expansion, simulation and backpropagation on its own
+	// copy of the game until the time or the playouts are over, the search is cancelled or stop is
+	// set. If reports, it tells budget the most visited child every PROGRESS_MS. Returns the number
+	// of playouts.
+	ull Node::work(Game game, TimeManager& budget, bool reports)
 	{
-		if (childs.empty()) return NULL;
-		return childs[rand_int(0, childs.size()-1)];
+		ull n = 0, checked = 0;
+		int next_report = PROGRESS_MS;
+		while (!budget.soft_stop() && !stop.load(memory_order_relaxed)) {
+			if (reports && budget.elapsed() >= next_report) {
+				Node* best = NULL;
+				for (Node* child = children(); child != NULL; child = child->sibling()) {
+					if (best == NULL || child->visits > best->visits) best = child;
+				}
+				budget.report(0, best != NULL ? best->play : NOPLAY, visits);
+				next_report = budget.elapsed() + PROGRESS_MS;
+			}
+
+			Node* node = this;
+			while (node->state.load(memory_order_acquire) == Expanded) {
+				Node* next = node->select();
+				if (next == NULL) break;
+				node = next;
+				node->visits += VIRTUAL_LOSS;
+				do_play(game, node->play, (Color)!node->color);
+			}
+			if (node->expand(game)) {
+				Node* next = node->select();
+				if (next != NULL) {
+					node = next;
+					node->visits += VIRTUAL_LOSS;
+					do_play(game, node->play, (Color)!node->color);
+				}
+			}
+
+			Playout::PlayList simulated;
+			Color winner = node->simulate(game, rave ? &simulated : NULL);
+			node->backpropagation(this, winner, rave ? &simulated : NULL);
+
+			// Restore:
+			for (; node != this; node = &arena[node->parent]) undo_play(game, node->play);
+			if (budget.out_of_time(++n, checked, 1)) break; // a playout is slow enough to check after each
+		}
+		return n;
 	}
 
-	void Node::destroy()
+	void Node::merge(Node* other) // adds the root statistics of other, a root with the same plays
 	{
-		for (Node* child : childs) {
-			child->destroy();
+		while (nchilds < other->nchilds && add_child() != NULL); // the plays other tried
+		for (Node* other_child = other->children(); other_child != NULL; other_child = other_child->sibling()) {
+			Node* node = find_child(other_child->play);
+			if (node != NULL) {
+				node->visits += other_child->visits;
+				node->wins += other_child->wins;
+				node->amaf_visits += other_child->amaf_visits;
+				node->amaf_wins += other_child->amaf_wins;
+				visits += other_child->visits;
+			}
 		}
-		delete this;
 	}
 
-	Node* Node::play_hive(Game& game)
+	// Runs simulations from this node (color to move) on AI::threads threads until the time (the
+	// soft limit, which the hard one never undercuts) or the playouts of limits are over and returns
+	// the most promising child, NULL if there are no plays. The tree is kept until the next
+	// new_tree or keep_subtree.
+	Node* Node::search(Game& game, const SearchLimits& limits)
 	{
-		// cout << "play_hive() - "; D(this) << endl;
-
-		clock_t time0;
-		clock_t simulation_time0;
-
-		reset_clock(time0);
+		TimeManager budget;
+		budget.start(limits);
 
 		expand(game);
 
-		reset_clock(simulation_time0);
-
-		// auto start = chrono::high_resolution_clock::now(); ///////////////////////////////////////
-		// ...
-		// auto elapsed = chrono::high_resolution_clock::now() - start; ////////////////////////////
-		// long long microseconds = chrono::duration_cast<chrono::microseconds>(elapsed).count(); //
-		// D(microseconds) << endl; ////////////////////////////////////////////////////////////////
-		
-		while (delta_time(time0) < TLE) {
-			for (int i = 0; i < 16; ++i) {
-				Node* promising = select();
-				do_play(game, promising->play, (Color)!promising->color);
-				promising->expand(game);
-				Node* to_explore = promising;
-				if (!promising->childs.empty()) {
-					to_explore = promising->random_child();
-				}
-
-				if (to_explore != promising) do_play(game, to_explore->play, (Color)!to_explore->color);
-
-				reset_clock(simulation_time0);
-				ll win = to_explore->simulate(game, simulation_time0, (Color)!to_explore->color); 
-				
-				to_explore->backpropagation(win);
-
-				// Restore:
-				if (to_explore != promising) undo_play(game, to_explore->play, (Color)!to_explore->color);
-				undo_play(game, promising->play, (Color)!promising->color);
+		V<Node*> roots(threads, this);
+		V<ull> counts(threads, 0);
+		V<thread> workers;
+		for (int i = 1; i < threads; ++i) {
+			int root = root_parallel ? arena.alloc(1) : -1;
+			if (root >= 0) { // shares the plays, so that children are made in the same order
+				roots[i] = &arena[root];
+				roots[i]->set_color(color);
+				roots[i]->set_play(play);
+				roots[i]->first_play = first_play;
+				roots[i]->nplays = nplays;
+				roots[i]->state = Expanded;
 			}
+			workers.push_back(thread([&roots, &counts, &game, &budget, i]() {
+				counts[i] = roots[i]->work(game, budget, false);
+			}));
 		}
+		counts[0] = work(game, budget, true);
+		for (thread& worker : workers) worker.join();
 
+		playouts = 0;
+		for (int i = 0; i < threads; ++i) {
+			playouts += counts[i];
+			if (roots[i] != this) merge(roots[i]); // its nodes are freed with the arena
+		}
+		playouts_per_sec = playouts * 1000 / max(1, budget.elapsed());
 
 		Node* best_node = NULL;
 		ld best_score = -INF;
 
-		int visits_sum = 0;
+		int visits_sum = 0, children_cnt = 0;
 
-		for (Node* child : childs) {
-			visits_sum += child->visits; /////////////////////
-			ld score = child->uct();
-			D(child->visits), D(child->play), D(score), D(child->wins) << endl;
+		for (Node* node = children(); node != NULL; node = node->sibling()) {
+			visits_sum += node->visits; /////////////////////
+			++children_cnt;
+			ld score = node->uct();
+			if (DEBUG) D(node->visits), D(node->play), D(score), D(node->wins) << endl;
 			if (score - best_score > -EPS) {  // update if greatest or equal score
 				best_score = score;
-				best_node = child;
+				best_node = node;
 			}
 		}
 
-		D((ld)visits_sum/childs.size()) << endl;
+		if (DEBUG) D(children_cnt), D(nplays), D((ld)visits_sum/max(1, children_cnt)), D(playouts), D(playouts_per_sec),
+			D(reused_visits), D(arena.size()), D((ld)arena.size()/max(1ULL, playouts)), D(moves.size()) << endl;
 
-		D(best_node) << endl;
-		if (best_node != NULL) {
-			D(best_node->play) << endl;
-			do_play(game, best_node->play, ia_color);
-		}
+		return best_node;
+	}
 
-		for (Node* child : childs) {
-			if (child != best_node) child->destroy();
+	// Same for time_ms milliseconds, IINF: until stop is set
+	Node* Node::search(Game& game, int time_ms)
+	{
+		SearchLimits limits;
+		if (time_ms < IINF) limits.move_ms = time_ms;
+		return search(game, limits);
+	}
+
+	Node* Node::play_hive(Game& game)
+	{
+		Node* best_node = search(game, TLE);
+		if (DEBUG) D(best_node) << endl;
+		if (best_node != NULL) {
+			if (DEBUG) D(best_node->play) << endl;
+			do_play(game, best_node->play, color);
 		}
 
 		return best_node;
+	}
+
+	// Pondering: once our play is made, node (the opponent to move) keeps being searched in the
+	// background on a copy of game. Every reply is searched, the one played keeps its subtree.
+	void start_pondering(Node* node, const Game& game)
+	{
+		stop_pondering();
+		if (node == NULL) return;
+		ponder_game = new Game(game);
+		ponder_thread = thread([node]() { node->search(*ponder_game, IINF); });
+	}
 
-		// if (DEBUG) D(delta_time()), D(max_depth) << endl;
+	// Stops pondering on node and returns the child of play, NULL if node is NULL or the
+	// search never tried play (a ponder miss)
+	Node* ponder_reply(Node* node, Play play)
+	{
+		bool pondering = (ponder_game != NULL);
+		stop_pondering();
+		Node* child = (node != NULL ? node->find_child(play) : NULL);
+		if (pondering) {
+			if (child != NULL) ++ponder_hits;
+			else ++ponder_misses;
+			if (DEBUG) D(ponder_hits), D(ponder_misses) << endl;
+		}
+		return child;
 	}
 
 };
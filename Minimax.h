@@ -2,96 +2,502 @@
 #define HIVE_MINIMAX_H
 
 #include "AI.h"
+#include "Evaluation.h"
+#include "TranspositionTable.h"
+#include "TimeManager.h"
+#include <thread>
 
 namespace Minimax
 {
 	using namespace AI;
 	using namespace std;
 
-	clock_t time0;
-	map<ull,PlayInfo> TT[TT_size];
+	const int MAXPLY = 64; // for the killer moves
+	const int HISTORY_MAX = 1 << 20; // the history table is halved when an entry reaches it
+	const ll ASPIRATION = 50; // half width of the first window around the previous iteration's score
+	const ll ASPIRATION_MAX = 5000; // a window wider than this is opened fully
+	const int QS_MAX_PLY = 8; // quiescence plies below a leaf
+	const int QS_NODES = 1000; // quiescence nodes per leaf
+	const int QS_MIN_SURROUND = 4; // quiescence only looks at leaves where a Bee has this many neighbours
 
-	PlayInfo minimax(Game& game, V<PlayInfo>& plays, Color color, int depth, int max_depth, ll alpha, ll beta)
+	const int LMR_MIN_PLAYS = 3; // plays searched at full depth before reductions start
+
+	bool quiescence = true;
+	bool null_move = true;
+	int null_move_r = 2; // depth reduction of the null move search
+	bool lmr = true;
+	int lmr_r = 1; // depth reduction of late plays
+
+	struct ThreadData { // everything a search thread writes, one per thread
+		ThreadData(const Game& _game) : game(_game) {};
+		Game game; // own copy, searched with do_play / undo_play
+		Color color; // side to move at the root
+		MoveList plays; // root plays, best first after each iteration
+		V<ll> scores; // scores[i]: score of plays[i] in the last iteration
+		Play best_play; // of the deepest completed iteration
+		ll best_score;
+		int completed_depth;
+		ull nodes;
+		ull checked_nodes; // of nodes, those added to tm
+		array<array<Play,2>,MAXPLY> killers; // ply -> the last two plays that caused a beta cutoff
+		array<array<int,NCELLS>,NPIECETYPES> history; // piece, destination cell -> cutoffs weighted by depth
+		ull cutoffs, first_cutoffs; // beta cutoffs, and how many of them by the first play searched
+		int researches; // aspiration windows that failed
+		ull qnodes; // in quiescence, also counted in nodes
+		ull null_cutoffs; // by a null move
+		ull lmr_researches; // reduced searches that failed high
+		bool aborted; // the current iteration ran out of time, its scores mean nothing
+		bool reports; // the main thread, it reports each completed iteration to tm
+	};
+
+	struct SearchInfo { // result of the last search
+		Play best_play;
+		ll best_score;
+		int depth; // deepest completed iteration
+		ull nodes; // all threads
+		int ms;
+		ull cutoffs, first_cutoffs; // all threads
+		int researches; // all threads
+		ull qnodes; // all threads
+		ull null_cutoffs, lmr_researches; // all threads
+	};
+
+	TimeManager tm; // limits of the current search
+	atomic<bool> stop(false); // set by the main thread to stop the helpers
+	TranspositionTable TT(TT_MB); // kept across iterations and turns, shared by all threads
+	SearchInfo info;
+
+	inline bool stopped(ThreadData& td) // any thread past the hard limit stops them all
+	{
+		if (stop.load(memory_order_relaxed)) return true;
+		if (!tm.out_of_time(td.nodes, td.checked_nodes)) return false;
+		stop = true;
+		return true;
+	}
+
+	void add_history(ThreadData& td, Play play, int bonus)
+	{
+		int& h = td.history[play.piece()][play.to()];
+		h += bonus;
+		if (h < HISTORY_MAX) return;
+		for (auto& piece : td.history) {
+			for (int& x : piece) x /= 2;
+		}
+	}
+
+	// Move ordering: the TT move, then the killers of this ply, then by history
+	void score_plays(ThreadData& td, const MoveList& plays, Play tt_move, int ply, FixedList<int,MAXPLAYS>& order)
 	{
-		assert(depth <= max_depth);
+		order.resize(plays.size());
+		for (int i = 0; i < plays.size(); ++i) {
+			Play play = plays[i];
+			if (play == tt_move) order[i] = 1 << 30;
+			else if (ply < MAXPLY && play == td.killers[ply][0]) order[i] = 1 << 29;
+			else if (ply < MAXPLY && play == td.killers[ply][1]) order[i] = 1 << 28;
+			else order[i] = td.history[play.piece()][play.to()];
+		}
+	}
 
-		if (delta_time(time0) >= TLE) return play_info_null();
+	// Swaps the best scored play left into position i
+	inline void pick_play(MoveList& plays, FixedList<int,MAXPLAYS>& order, int i)
+	{
+		int best = i;
+		for (int j = i+1; j < plays.size(); ++j) {
+			if (order[j] > order[best]) best = j;
+		}
+		swap(plays[i], plays[best]);
+		swap(order[i], order[best]);
+	}
 
-		ull H = game.hash(depth); 
-		int TT_idx = H % TT_size; // transposition table
-		auto TTtree = TT[TT_idx];
-		auto TT_it = TTtree.find(H);
-		if (TT_it != TTtree.end()) {
-			return TT_it->second;
+	// Whether play changes the number of pieces around a Bee, or moves a Bee
+	bool is_forcing(Game& game, Play play)
+	{
+		if (play.piece() == Piece::Bee) return true;
+		for (Color c : COLORS) {
+			if (!game.bee_spawned[c]) continue;
+			Hex bee = game.positions[c][Piece::Bee][0];
+			const array<short,6>& around = NEIGHBOUR[cell_index(bee.x, bee.y)];
+			bool fills = play.to_layer() == 0 && find(around.begin(), around.end(), play.to()) != around.end();
+			bool vacates = play.type() == PlayType::Move && play.from_layer() == 0
+				&& find(around.begin(), around.end(), play.from()) != around.end();
+			if (fills != vacates) return true;
+		}
+		return false;
+	}
+
+	int max_surround(Game& game) // neighbours of the most surrounded Bee
+	{
+		int surround = 0;
+		for (Color c : COLORS) {
+			if (game.bee_spawned[c]) surround = max(surround, game.surrounding_cnt(game.positions[c][Piece::Bee][0]));
 		}
+		return surround;
+	}
 
-		PlayInfo best_play;
-		best_play.type = PlayType::NoPlay;
-		best_play.score = (color == ia_color ? -LINF : LINF);
+	// Fail-soft search of the forcing plays only, from a leaf of pvs. The side to move may stand
+	// pat on the static score. budget: nodes left for this leaf.
+	ll qsearch(ThreadData& td, Game& game, Color color, int qply, ll alpha, ll beta, int& budget)
+	{
+		if (td.aborted || stopped(td)) {
+			td.aborted = true;
+			return 0;
+		}
+		++td.nodes, ++td.qnodes, --budget;
 
 		Color winner = game.winner();
-		// if (DEBUG) D(winner) << endl;
 		if (winner != Color::NoColor) {
-			best_play.score = (winner == ia_color ? LINF : -LINF);
-			return best_play;
+			return (winner == color ? LINF : -LINF);
 		}
+		ll best_score = evaluate(game, color); // stand pat
+		if (best_score >= beta || qply >= QS_MAX_PLY || budget <= 0) return best_score;
+		if (max_surround(game) < QS_MIN_SURROUND) return best_score; // quiet position
+		alpha = max(alpha, best_score);
 
-		for (PlayInfo& play : plays) {
+		MoveList plays;
+		gen_plays(game, color, plays);
+		for (Play play : plays) {
+			if (!is_forcing(game, play)) continue;
 			do_play(game, play, color);
+			ll score = -qsearch(td, game, (Color)!color, qply+1, -beta, -alpha, budget);
+			undo_play(game, play);
+			if (td.aborted) return 0;
+			if (score > best_score) {
+				best_score = score;
+				alpha = max(alpha, score);
+				if (alpha >= beta) break;
+			}
+		}
+		return best_score;
+	}
+
+	// Principal variation search (negamax, fail-soft). Returns the score of the position for color, the
+	// side to move, searched depth plies deep, and sets best_play. ply: distance from the root. At the
+	// root (scores != NULL) td.plays are searched in their order and scores[i] gets the score of plays[i].
+	// null_ok: the last play was not a null move.
+	ll pvs(ThreadData& td, Game& game, Color color, int ply, int depth, ll alpha, ll beta, Play& best_play, bool null_ok = true, ll* scores = NULL)
+	{
+		best_play = NOPLAY;
+		if (td.aborted || stopped(td)) {
+			td.aborted = true;
+			return 0;
+		}
+		++td.nodes;
+
+		ull H = game.hash(color);
+		TTData tt_data;
+		Play tt_move = NOPLAY;
+		if (ply > 0 && TT.probe(H, tt_data)) {
+			tt_move = tt_data.move;
+			if (tt_data.depth >= depth
+				&& (tt_data.bound == Bound::Exact
+					|| (tt_data.bound == Bound::Lower && tt_data.score >= beta)
+					|| (tt_data.bound == Bound::Upper && tt_data.score <= alpha)))
+			{
+				best_play = tt_data.move;
+				return tt_data.score;
+			}
+		}
+		ll alpha0 = alpha;
 
-			if (depth == max_depth) {
-				play.score = get_heuristic_score(game);
+		Color winner = game.winner();
+		// if (DEBUG) D(winner) << endl;
+		if (winner != Color::NoColor) {
+			return (winner == color ? LINF : -LINF);
+		}
+		if (depth <= 0) {
+			if (!quiescence) return evaluate(game, color);
+			int budget = QS_NODES;
+			return qsearch(td, game, color, 0, alpha, beta, budget);
+		}
+
+		// Null move: if passing still fails high at a reduced depth, a real play will too. Not near
+		// a surrounded Bee, where passing could be the only way not to lose (zugzwang).
+		bool pv = beta - 1 > alpha; // not beta - alpha, which overflows on the full window
+		if (null_move && null_ok && !pv && ply > 0 && depth > null_move_r && max_surround(game) < QS_MIN_SURROUND
+			&& evaluate(game, color) >= beta)
+		{
+			Play next_best;
+			ll score = -pvs(td, game, (Color)!color, ply+1, depth-1-null_move_r, -beta, -beta+1, next_best, false);
+			if (td.aborted) return 0;
+			if (score >= beta) {
+				++td.null_cutoffs;
+				return score;
 			}
-			else {
-				V<PlayInfo> next_plays = gen_plays(game, (Color)!color);
-				play.score = minimax(game, next_plays, (Color)!color, depth+1, max_depth, alpha, beta).score;
+		}
+
+		MoveList local_plays;
+		if (scores == NULL) gen_plays(game, color, local_plays);
+		MoveList& plays = (scores == NULL ? local_plays : td.plays);
+		FixedList<int,MAXPLAYS> order;
+		if (scores == NULL) score_plays(td, plays, tt_move, ply, order);
+
+		ll best_score = -LINF;
+		for (int i = 0; i < plays.size(); ++i) {
+			if (scores == NULL) pick_play(plays, order, i);
+			Play play = plays[i];
+			// Late move reduction: plays ordered after the TT move, the killers and the first
+			// few by history are searched shallower first, unless they are forcing
+			int reduction = 0;
+			if (lmr && i >= LMR_MIN_PLAYS && depth > lmr_r && (scores != NULL || order[i] < (1 << 28))
+				&& !is_forcing(game, play))
+			{
+				reduction = lmr_r;
 			}
-			// if (DEBUG) D(play.score) << endl;
+			do_play(game, play, color);
 
-			if (color == ia_color) { // maximize
-				if (play > best_play) best_play = play;
-				alpha = max(alpha, best_play.score);
+			Play next_best;
+			ll score;
+			if (i == 0) {
+				score = -pvs(td, game, (Color)!color, ply+1, depth-1, -beta, -alpha, next_best);
 			}
-			else { // minimize
-				if (play < best_play) best_play = play;
-				beta = min(beta, best_play.score);
+			else { // null window: prove that play is not better than the first one
+				score = -pvs(td, game, (Color)!color, ply+1, depth-1-reduction, -alpha-1, -alpha, next_best);
+				if (reduction > 0 && score > alpha && !td.aborted) {
+					++td.lmr_researches;
+					score = -pvs(td, game, (Color)!color, ply+1, depth-1, -alpha-1, -alpha, next_best);
+				}
+				if (score > alpha && score < beta && !td.aborted) {
+					score = -pvs(td, game, (Color)!color, ply+1, depth-1, -beta, -alpha, next_best);
+				}
 			}
-			
-			undo_play(game, play, color);
+			// if (DEBUG) D(score) << endl;
+			if (scores != NULL) scores[i] = score;
 
-			if (beta <= alpha) return best_play;
-		}
+			undo_play(game, play);
+			if (td.aborted) return 0; // score is not a score
 
-		if (best_play.type == PlayType::NoPlay) {
-			best_play.score = (color == ia_color ? -LINF : LINF);
+			if (score > best_score || best_play == NOPLAY) best_score = score, best_play = play;
+			if (best_score > alpha) alpha = best_score;
+			if (alpha >= beta) {
+				++td.cutoffs;
+				if (i == 0) ++td.first_cutoffs;
+				if (ply < MAXPLY && play != td.killers[ply][0]) {
+					td.killers[ply][1] = td.killers[ply][0];
+					td.killers[ply][0] = play;
+				}
+				add_history(td, play, depth * depth);
+				break;
+			}
 		}
-		TTtree[H] = best_play; // memoize
-		return best_play;
+
+		if (plays.empty()) best_score = evaluate(game, color); // no plays: the turn passes
+
+		Bound bound = (best_score <= alpha0 ? Bound::Upper : best_score >= beta ? Bound::Lower : Bound::Exact);
+		TT.store(H, depth, bound, best_score, best_play); // memoize
+		return best_score;
 	}
 
-	void play_hive(Game& game)
+	// Iterative deepening on td's root. Helpers start one ply deeper every other thread so
+	// that threads work on different depths and fill the TT for each other. Each iteration
+	// starts with an aspiration window around the last score and widens it on a fail low or
+	// high. An iteration that runs out of time is dropped, the last completed one stands.
+	void iterate(ThreadData& td, int start_depth)
 	{
-		reset_clock(time0);
-		V<PlayInfo> plays = gen_plays(game, ia_color);
-		PlayInfo best_play = play_info_null();
-		best_play.score = -LINF;
-		int max_depth = 1;
-		for (max_depth = 1; delta_time(time0) < TLE; ++max_depth) { // iterative deepening
-			for (int i = 0; i < TT_size; ++i) {
-				TT[i].clear();
+		for (int max_depth = start_depth; max_depth <= tm.depth && !stop && !tm.soft_stop(); ++max_depth) {
+			ll alpha = -LINF, beta = LINF, delta = ASPIRATION;
+			if (td.completed_depth > 0 && td.best_score > -LINF && td.best_score < LINF) { // not a won or lost game
+				alpha = td.best_score - delta, beta = td.best_score + delta;
+			}
+			Play play;
+			ll score;
+			while (true) {
+				score = pvs(td, td.game, td.color, 0, max_depth, alpha, beta, play, true, td.scores.data());
+				if (td.aborted) break;
+				if (score > alpha && score < beta) break;
+				if (score <= alpha && (alpha == -LINF || score == -LINF)) break; // open window or proven loss
+				if (score >= beta && (beta == LINF || score == LINF)) break; // open window or proven win
+				++td.researches;
+				delta *= 4;
+				if (score <= alpha) alpha = (delta > ASPIRATION_MAX || alpha <= -LINF + delta ? -LINF : alpha - delta);
+				else beta = (delta > ASPIRATION_MAX || beta >= LINF - delta ? LINF : beta + delta);
 			}
-			PlayInfo play = minimax(game, plays, ia_color, 0, max_depth, -LINF, LINF);
-			if (play > best_play) best_play = play;
-			sort(plays.begin(), plays.end(), [](const PlayInfo& a, const PlayInfo& b) {
-				return a > b;
+			if (td.aborted) break; // incomplete iteration
+			td.best_play = play, td.best_score = score, td.completed_depth = max_depth;
+			if (td.reports) tm.report(max_depth, play, tm.searched() + td.nodes - td.checked_nodes); // the helpers up to their last check
+			V<pair<ll,unsigned int> > order; // best first for the next iteration
+			for (int i = 0; i < td.plays.size(); ++i) order.push_back(make_pair(td.scores[i], td.plays[i].code));
+			stable_sort(order.begin(), order.end(), [](const pair<ll,unsigned int>& a, const pair<ll,unsigned int>& b) {
+				return a.first > b.first;
 			});
+			for (int i = 0; i < td.plays.size(); ++i) td.scores[i] = order[i].first, td.plays[i].code = order[i].second;
+		}
+	}
+
+	// Best play for color within the limits given to tm, NOPLAY if there is none.
+	// Lazy SMP: the main thread and AI::threads-1 helpers search the same root.
+	Play run_search(Game& game, Color color)
+	{
+		V<ThreadData*> tds;
+		for (int i = 0; i < threads; ++i) {
+			ThreadData* td = new ThreadData(game);
+			td->color = color;
+			gen_plays(td->game, color, td->plays); // shuffled differently in each thread
+			td->scores.assign(td->plays.size(), -LINF);
+			td->best_play = td->plays.empty() ? NOPLAY : td->plays[0]; // if not even depth 1 completes
+			td->best_score = -LINF;
+			td->completed_depth = 0;
+			td->nodes = td->checked_nodes = 0;
+			for (auto& killers : td->killers) killers.fill(NOPLAY);
+			for (auto& piece : td->history) piece.fill(0);
+			td->cutoffs = td->first_cutoffs = 0;
+			td->researches = 0;
+			td->qnodes = 0;
+			td->null_cutoffs = td->lmr_researches = 0;
+			td->aborted = false;
+			td->reports = (i == 0);
+			tds.push_back(td);
+		}
+		V<thread> helpers;
+		for (int i = 1; i < threads; ++i) {
+			helpers.push_back(thread(iterate, ref(*tds[i]), 1 + i % 2));
+		}
+		iterate(*tds[0], 1);
+		stop = true;
+		for (thread& helper : helpers) helper.join();
+
+		ThreadData* best = tds[0]; // the deepest completed iteration, the main thread on ties
+		info.nodes = info.cutoffs = info.first_cutoffs = 0;
+		info.researches = 0;
+		info.qnodes = info.null_cutoffs = info.lmr_researches = 0;
+		for (ThreadData* td : tds) {
+			if (td->completed_depth > best->completed_depth) best = td;
+			info.nodes += td->nodes;
+			info.cutoffs += td->cutoffs;
+			info.first_cutoffs += td->first_cutoffs;
+			info.researches += td->researches;
+			info.qnodes += td->qnodes;
+			info.null_cutoffs += td->null_cutoffs;
+			info.lmr_researches += td->lmr_researches;
+		}
+		info.best_play = best->best_play;
+		info.best_score = best->best_score;
+		info.depth = best->completed_depth;
+		info.ms = tm.elapsed();
+		for (ThreadData* td : tds) delete td;
+		if (DEBUG) D(info.ms), D(info.best_play), D(info.best_score), D(info.depth), D(info.nodes),
+			D((ld)info.first_cutoffs / max(1ULL, info.cutoffs)), D(info.researches), D(info.qnodes),
+			D(info.null_cutoffs), D(info.lmr_researches) << endl;
+		return info.best_play;
+	}
+
+	void stop_pondering();
+
+	// Best play for color within limits, NOPLAY if there is none. Stops any ponder search,
+	// which shares tm, stop and info.
+	Play search(Game& game, Color color, const SearchLimits& limits)
+	{
+		stop_pondering();
+		tm.start(limits);
+		stop = false;
+		TT.new_search();
+		return run_search(game, color);
+	}
+
+	// Best play for color found within time_ms milliseconds and depth_limit plies (IINF: no limit)
+	Play search(Game& game, Color color, int time_ms, int depth_limit = IINF)
+	{
+		SearchLimits limits;
+		if (time_ms < IINF) limits.move_ms = time_ms;
+		if (depth_limit < IINF) limits.depth = depth_limit;
+		return search(game, color, limits);
+	}
+
+	// Pondering: after our play, the reply the TT expects is made on a copy of the game and
+	// searched in the background until the opponent plays. On a hit that search goes on under
+	// the limits of our turn, on a miss it is stopped and only what it stored in the TT is kept.
+	bool ponder = false;
+	ull ponder_hits = 0, ponder_misses = 0;
+	Play ponder_play = NOPLAY; // the expected reply, NOPLAY when not pondering
+	Game* ponder_game = NULL; // ponder_play made
+	Play ponder_best; // result of the ponder search
+	thread ponder_thread;
+
+	// The reply of color the TT expects, NOPLAY if it has none
+	Play predicted_play(Game& game, Color color)
+	{
+		TTData tt_data;
+		if (!TT.probe(game.hash(color), tt_data) || tt_data.move == NOPLAY) return NOPLAY;
+		MoveList plays;
+		gen_plays(game, color, plays);
+		for (Play play : plays) { // the TT entry may belong to another position
+			if (play == tt_data.move) return play;
 		}
-		if (DEBUG) D(delta_time(time0)), D(best_play), D(max_depth) << endl;
-		if (best_play.type == PlayType::Put) {
-			game.put_piece(best_play.h.x, best_play.h.y, ia_color, best_play.piece, true);
+		return NOPLAY;
+	}
+
+	void stop_pondering()
+	{
+		if (ponder_play == NOPLAY) return;
+		stop = true;
+		ponder_thread.join();
+		delete ponder_game;
+		ponder_game = NULL;
+		ponder_play = NOPLAY;
+	}
+
+	// Ponders on game, opponent to move. False if there is no expected reply.
+	bool start_pondering(const Game& game, Color opponent)
+	{
+		stop_pondering();
+		ponder_game = new Game(game);
+		ponder_play = predicted_play(*ponder_game, opponent);
+		if (ponder_play == NOPLAY) {
+			delete ponder_game;
+			ponder_game = NULL;
+			return false;
+		}
+		do_play(*ponder_game, ponder_play, opponent);
+		SearchLimits limits;
+		limits.depth = MAXPLY; // no time limit until the opponent plays
+		tm.start(limits);
+		stop = false;
+		TT.new_search();
+		Color color = (Color)!opponent;
+		ponder_thread = thread([color]() { ponder_best = run_search(*ponder_game, color); });
+		return true;
+	}
+
+	// The opponent played play. True on a ponder hit, the search keeps going until
+	// finish_pondering(). On a miss the search is stopped.
+	bool ponder_hit(Play play)
+	{
+		if (ponder_play == NOPLAY) return false;
+		if (play == ponder_play) {
+			++ponder_hits;
+			return true;
 		}
-		else if (best_play.type == PlayType::Move) {
-			game.move_piece(best_play.h2.x, best_play.h2.y, best_play.h, best_play.h2.layer, true);
+		++ponder_misses;
+		stop_pondering();
+		return false;
+	}
+
+	// After a ponder hit: the best play once the search used limits, counted from now
+	Play finish_pondering(const SearchLimits& limits)
+	{
+		tm.restart(limits);
+		ponder_thread.join();
+		delete ponder_game;
+		ponder_game = NULL;
+		ponder_play = NOPLAY;
+		if (DEBUG) D(ponder_hits), D(ponder_misses) << endl;
+		return ponder_best;
+	}
+
+	// The play of ia_color on game within limits. player_play: the reply to our last play,
+	// to check the ponder search. Does not change game, so it can run in another thread.
+	Play choose_play(Game& game, Play player_play, const SearchLimits& limits)
+	{
+		return (ponder_hit(player_play) ? finish_pondering(limits) : search(game, ia_color, limits));
+	}
+
+	void play_hive(Game& game, Play player_play = NOPLAY)
+	{
+		SearchLimits limits;
+		limits.move_ms = TLE;
+		Play best_play = choose_play(game, player_play, limits);
+		if (best_play != NOPLAY) {
+			do_play(game, best_play, ia_color);
+			if (ponder) start_pondering(game, player_color);
 		}
 		else {
 			// unable to move. TODO: check this case
@@ -99,4 +505,4 @@ namespace Minimax
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,68 @@
+#ifndef HIVE_PLAY_H
+#define HIVE_PLAY_H
+
+#include "Bitboard.h"
+#include "Hex.h"
+
+namespace Hive
+{
+
+	enum PlayType { NoPlay, Put, Move };
+
+	struct Play { // 32 bits: type 2, piece 3, from cell 10 + layer 1, to cell 10 + layer 1
+		unsigned int code;
+		inline PlayType type() const { return (PlayType)(code & 3); };
+		inline Piece piece() const { return (Piece)((code >> 2) & 7); };
+		inline int from() const { return (code >> 5) & 1023; }; // PlayType == Move
+		inline int from_layer() const { return (code >> 15) & 1; };
+		inline int to() const { return (code >> 16) & 1023; };
+		inline int to_layer() const { return (code >> 26) & 1; };
+		inline Hex h() const { return Hex(from_layer(), cell_x(from()), cell_y(from())); }; // Put: spawn hex
+		inline Hex h2() const { return Hex(to_layer(), cell_x(to()), cell_y(to())); };
+	};
+
+	const Play NOPLAY = { 0 };
+
+	inline bool operator==(const Play& a, const Play& b)
+	{
+		return a.code == b.code;
+	}
+
+	inline bool operator!=(const Play& a, const Play& b)
+	{
+		return a.code != b.code;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const Play& p)
+    {  
+        os << '{';
+		if (p.type() == PlayType::Put) {
+			os << "Put, " << p.h2() << ", " << int(p.piece());
+		}
+		else if (p.type() == PlayType::Move) {
+			os << "Move, " << int(p.piece()) << ", " << p.h() << ", " << p.h2();
+		}
+		else {
+			os << "NoPlay";
+		}
+		os << '}';
+        return os;  
+    }
+
+	inline Play play_put(Hex h, Piece piece)
+	{
+		int c = cell_index(h.x, h.y);
+		Play p = { (unsigned int)(PlayType::Put | (piece << 2) | (c << 5) | (c << 16)) }; // from == to
+		return p;
+	}
+
+	inline Play play_move(Hex h, Hex h2, Piece piece)
+	{
+		Play p = { (unsigned int)(PlayType::Move | (piece << 2) | (cell_index(h.x, h.y) << 5) | (h.layer << 15)
+			| (cell_index(h2.x, h2.y) << 16) | (h2.layer << 26)) };
+		return p;
+	}
+
+}
+
+#endif
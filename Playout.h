@@ -0,0 +1,203 @@
+#ifndef HIVE_PLAYOUT_H
+#define HIVE_PLAYOUT_H
+
+#include "AI.h"
+#include <atomic>
+
+namespace Playout
+{
+	using namespace AI;
+	using namespace std;
+
+	const int DEPTH = 24; // plies per playout
+	typedef FixedList<Play,DEPTH> PlayList;
+
+	ld epsilon = 0; // chance of a play next to the enemy Bee instead of a random one, when there is one
+
+	class Xoshiro128 // xoshiro128**: 16 bytes of state and a few operations per number
+	{
+		public:
+			Xoshiro128(ull seed);
+			inline unsigned int next();
+			inline unsigned int below(unsigned int n) { return (ull)next() * n >> 32; }; // in [0, n)
+			inline bool chance(ld p) { return next() < p * 4294967296.0L; };
+		private:
+			static inline unsigned int rotl(unsigned int x, int k) { return (x << k) | (x >> (32 - k)); };
+			array<unsigned int,4> s;
+	};
+
+	Xoshiro128::Xoshiro128(ull seed)
+	{
+		for (unsigned int& x : s) { // splitmix64, so that close seeds give unrelated states
+			seed += 0x9E3779B97F4A7C15ULL;
+			ull z = seed;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			x = (z ^ (z >> 31)) | 1;
+		}
+	}
+
+	inline unsigned int Xoshiro128::next()
+	{
+		unsigned int result = rotl(s[1] * 5, 7) * 9;
+		unsigned int t = s[1] << 9;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 11);
+		return result;
+	}
+
+	inline Xoshiro128& rng() // one per thread
+	{
+		static atomic<ull> seeds(rand());
+		thread_local Xoshiro128 r(seeds.fetch_add(1));
+		return r;
+	}
+
+	// Sets target to a random target of h that gen_plays would accept, false if there is none
+	bool random_target(Game& game, Hex h, Xoshiro128& r, Hex& target)
+	{
+		HexList targets;
+		game.valid_moves(h, targets);
+		int n = targets.size();
+		for (int i = 0, start = r.below(max(n, 1)); i < n; ++i) {
+			Hex p = targets[(start + i) % n];
+			if (game.is_outside(p) || game.grid[p.x][p.y][p.layer].piece != Piece::NoPiece) continue;
+			target = p;
+			return true;
+		}
+		return false;
+	}
+
+	// A random cell where color can put a piece, tried next to its own pieces so that the whole
+	// spawn_cells() is not needed. False if there was no luck, the caller falls back to spawn_cells().
+	bool random_spawn(Game& game, Color color, const FixedList<Hex,NPIECERPERPLAYER>& own, Xoshiro128& r, int& cell)
+	{
+		if (own.empty()) return false; // first pieces of the game, spawn_cells() has the special cases
+		for (int attempt = 0; attempt < 8; ++attempt) {
+			Hex h = own[r.below(own.size())];
+			int c = NEIGHBOUR[cell_index(h.x, h.y)][r.below(6)];
+			if (c < 0 || game.occupied[0].test(c)) continue;
+			bool touches_enemy = false; // a beetle on top owns the stack
+			for (int n : NEIGHBOUR[c]) {
+				if (n < 0) continue;
+				touches_enemy |= game.color_bb[1][!color].test(n) || (game.color_bb[0][!color].test(n) && !game.occupied[1].test(n));
+			}
+			if (touches_enemy) continue;
+			cell = c;
+			return true;
+		}
+		return false;
+	}
+
+	// A play that adds a piece around the Bee of !color, NOPLAY if there is none
+	Play surround_play(Game& game, Color color, const FixedList<Piece,NPIECETYPES>& puts,
+		const FixedList<Hex,NPIECERPERPLAYER>& pieces, Bitboard& spawns, bool& spawns_valid, Xoshiro128& r)
+	{
+		if (!game.bee_spawned[!color]) return NOPLAY;
+		Hex bee = game.positions[!color][Piece::Bee][0];
+		if (game.surrounding_cnt(bee) == 6) return NOPLAY;
+		int bee_cell = cell_index(bee.x, bee.y);
+		Bitboard around;
+		for (int n : NEIGHBOUR[bee_cell]) {
+			if (n >= 0 && !game.occupied[0].test(n)) around.set(n);
+		}
+
+		if (!puts.empty()) { // only possible when a Beetle covers the Bee
+			if (!spawns_valid) spawns = game.spawn_cells(color), spawns_valid = true;
+			Bitboard cells = spawns & around;
+			if (cells.any()) {
+				int c = cells.nth(r.below(cells.count()));
+				return play_put(Hex(0, cell_x(c), cell_y(c)), puts[r.below(puts.size())]);
+			}
+		}
+		int n = pieces.size();
+		for (int i = 0, start = r.below(max(n, 1)); i < n; ++i) {
+			Hex h = pieces[(start + i) % n];
+			bool adjacent = false; // moving it would not add a neighbour
+			for (int c : NEIGHBOUR[bee_cell]) adjacent |= (h.layer == 0 && c == cell_index(h.x, h.y));
+			if (adjacent) continue;
+			HexList targets;
+			game.valid_moves(h, targets);
+			for (Hex p : targets) {
+				if (p.layer == 0 && around.test(cell_index(p.x, p.y)) && !game.is_outside(p)) return play_move(h, p, h.piece);
+			}
+		}
+		return NOPLAY;
+	}
+
+	// A random valid play of color, NOPLAY if there is none. Instead of listing every play,
+	// it draws a placement or a piece and only generates the targets of what it drew.
+	Play random_play(Game& game, Color color, Xoshiro128& r)
+	{
+		FixedList<Piece,NPIECETYPES> puts; // piece types color can put
+		bool bee_only = !game.bee_spawned[color] && NPIECERPERPLAYER - game.total_pieces_left[color] >= 3;
+		for (Piece piece : PIECES) {
+			if (game.pieces_left[color][piece] > 0 && (!bee_only || piece == Piece::Bee)) puts.push_back(piece);
+		}
+		FixedList<Hex,NPIECERPERPLAYER> own; // pieces of color not covered by a Beetle
+		for (Piece piece : PIECES) {
+			for (Hex h : game.positions[color][piece]) {
+				if (!game.is_locked(h)) own.push_back(h);
+			}
+		}
+		FixedList<Hex,NPIECERPERPLAYER> pieces; // pieces of color that may move, pinned ones are dropped when drawn
+		if (game.bee_spawned[color]) pieces = own;
+
+		Bitboard spawns;
+		bool spawns_valid = false;
+		if (epsilon > 0 && r.chance(epsilon)) {
+			Play play = surround_play(game, color, puts, pieces, spawns, spawns_valid, r);
+			if (play != NOPLAY) return play;
+		}
+
+		while (!puts.empty() || !pieces.empty()) {
+			if (!puts.empty() && (pieces.empty() || r.below(2))) { // half the plays are placements, they are cheap
+				int c;
+				if (!spawns_valid && random_spawn(game, color, own, r, c)) {
+					return play_put(Hex(0, cell_x(c), cell_y(c)), puts[r.below(puts.size())]);
+				}
+				if (!spawns_valid) spawns = game.spawn_cells(color), spawns_valid = true;
+				int cnt = spawns.count();
+				if (cnt == 0) {
+					puts.clear();
+					continue;
+				}
+				c = spawns.nth(r.below(cnt));
+				return play_put(Hex(0, cell_x(c), cell_y(c)), puts[r.below(puts.size())]);
+			}
+			int i = r.below(pieces.size());
+			Hex h = pieces[i];
+			Hex p;
+			if (random_target(game, h, r, p)) return play_move(h, p, h.piece);
+			pieces[i] = pieces.back(); // h cannot move
+			pieces.pop_back();
+		}
+		return NOPLAY;
+	}
+
+	// Plays up to DEPTH random plays from game, color to move, and undoes them. If plays != NULL
+	// it gets them. Returns the winner, NoColor if there is none by then.
+	Color playout(Game& game, Color color, PlayList* plays = NULL)
+	{
+		Xoshiro128& r = rng();
+		int plies = 0;
+		Color winner = game.winner();
+		while (winner == Color::NoColor && plies < DEPTH) {
+			Play play = random_play(game, color, r);
+			if (play == NOPLAY) break;
+			game.make_move(play, color);
+			if (plays != NULL) plays->push_back(play);
+			++plies;
+			color = (Color)!color;
+			winner = game.winner();
+		}
+		for (; plies > 0; --plies) game.unmake_move();
+		return winner;
+	}
+};
+
+#endif
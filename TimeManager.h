@@ -0,0 +1,118 @@
+#ifndef HIVE_TIMEMANAGER_H
+#define HIVE_TIMEMANAGER_H
+
+#include "AI.h"
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <mutex>
+
+namespace AI
+{
+	struct Progress { // reported by a running search
+		int depth; // Minimax: last completed iteration, MCTS: 0
+		Play best_play;
+		ull nodes; // Minimax: nodes, MCTS: playouts through the root
+		int ms;
+	};
+
+	struct SearchLimits { // 0: no limit of that kind
+		SearchLimits() : move_ms(0), clock_ms(0), inc_ms(0), moves_to_go(0), depth(0), nodes(0), cancel(NULL) {};
+		int move_ms; // fixed time for this move
+		int clock_ms; // time left on the game clock, used when move_ms == 0
+		int inc_ms; // added to the clock after each move
+		int moves_to_go; // moves until the clock is refilled, 0: the clock must last the game
+		int depth;
+		ull nodes; // all threads
+		const std::atomic<bool>* cancel; // once true the search ends and its best play so far stands, NULL: never
+		std::function<void(const Progress&)> progress; // called by a search thread, empty: no reports
+	};
+
+	// Turns SearchLimits into a soft limit, past which no new iteration starts, and a hard
+	// limit, past which the search aborts. Searchers call out_of_time() at every node, but the
+	// clock is only read, and the nodes of the thread added to the total, every CHECK_NODES nodes
+	// of each thread (every node for MCTS, whose nodes are playouts), or more often near a node
+	// limit, so that the threads together overshoot it by little. The limits can be replaced
+	// while a search runs (after a ponder hit), the start time stays. It also carries the
+	// cancellation token and the progress callback of the limits to the search threads.
+	class TimeManager
+	{
+		public:
+			static const int CHECK_NODES = 1024;
+			static const int MOVES_LEFT = 30; // moves the clock is shared by when moves_to_go == 0
+			void start(const SearchLimits& limits);
+			void restart(const SearchLimits& limits); // limits from now on, for the running search
+			// thread_nodes: nodes of the calling thread so far, checked: those of them already
+			// added to the total (0 at the start of the search), updated on each check
+			inline bool out_of_time(ull thread_nodes, ull& checked, ull check = CHECK_NODES);
+			inline bool soft_stop() const { return cancelled() || elapsed() >= soft_ms; }; // no time for another iteration
+			inline bool cancelled() const { const std::atomic<bool>* c = cancel; return c != NULL && c->load(std::memory_order_relaxed); };
+			inline int elapsed() const { return delta_time(time0); };
+			inline ull searched() const { return nodes; }; // all threads, up to the last check of each
+			void report(int depth, Play best_play, ull nodes); // to the progress callback, if any
+			std::atomic<int> soft_ms, hard_ms; // IINF if there is no time limit
+			std::atomic<int> depth; // IINF if there is no depth limit
+		private:
+			time_point time0;
+			std::atomic<ull> max_nodes; // 0: no node limit
+			std::atomic<ull> check_nodes; // each thread's share of the nodes left, or no limit
+			std::atomic<ull> nodes; // all threads, up to the last check of each
+			std::atomic<const std::atomic<bool>*> cancel;
+			std::function<void(const Progress&)> progress;
+			std::mutex progress_mutex; // restart() may replace progress while a thread reports
+	};
+
+	void TimeManager::start(const SearchLimits& limits)
+	{
+		reset_clock(time0);
+		nodes = 0;
+		restart(limits);
+	}
+
+	void TimeManager::restart(const SearchLimits& limits)
+	{
+		int now = elapsed();
+		cancel = limits.cancel;
+		{
+			std::lock_guard<std::mutex> lock(progress_mutex);
+			progress = limits.progress;
+		}
+		max_nodes = (limits.nodes > 0 ? nodes + limits.nodes : 0);
+		check_nodes = (limits.nodes > 0 ? std::max(1ULL, limits.nodes / threads) : std::numeric_limits<ull>::max());
+		depth = (limits.depth > 0 ? limits.depth : IINF);
+		int soft = IINF, hard = IINF;
+		if (limits.move_ms > 0) {
+			soft = hard = limits.move_ms;
+		}
+		else if (limits.clock_ms > 0) {
+			int reserve = min(limits.clock_ms / 20, 1000); // for the latency between us and the clock
+			int available = max(limits.clock_ms - reserve, 1);
+			int moves = (limits.moves_to_go > 0 ? limits.moves_to_go : MOVES_LEFT);
+			soft = available / moves + limits.inc_ms * 3 / 4;
+			hard = min(available, soft * 4);
+			soft = min(soft, hard);
+		}
+		soft_ms = (soft < IINF ? now + soft : IINF);
+		hard_ms = (hard < IINF ? now + hard : IINF);
+	}
+
+	void TimeManager::report(int depth, Play best_play, ull nodes)
+	{
+		std::lock_guard<std::mutex> lock(progress_mutex);
+		if (!progress) return;
+		Progress p;
+		p.depth = depth, p.best_play = best_play, p.nodes = nodes, p.ms = elapsed();
+		progress(p);
+	}
+
+	inline bool TimeManager::out_of_time(ull thread_nodes, ull& checked, ull check)
+	{
+		if (thread_nodes - checked < std::min(check, check_nodes.load(std::memory_order_relaxed))) return false;
+		ull total = (nodes += thread_nodes - checked);
+		checked = thread_nodes;
+		if (max_nodes > 0 && total < max_nodes) check_nodes = std::max(1ULL, (max_nodes - total) / threads);
+		return (max_nodes > 0 && total >= max_nodes) || (hard_ms < IINF && elapsed() >= hard_ms) || cancelled();
+	}
+}
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef HIVE_TRANSPOSITIONTABLE_H
+#define HIVE_TRANSPOSITIONTABLE_H
+
+#include "AI.h"
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+namespace AI
+{
+	enum Bound { NoBound = 0, Exact = 1, Lower = 2, Upper = 3 };
+
+	const ll TT_SCORE_MAX = (1LL << 22) - 1; // scores are stored in 23 signed bits, saturating to +-LINF
+
+	struct TTData {
+		ll score;
+		int depth;
+		Bound bound;
+		Play move;
+		int age;
+	};
+
+	// Fixed-size table shared by all searchers. Each entry is two 64-bit words,
+	// {key ^ data, data}: a torn write from another thread makes the xor check
+	// fail instead of returning a wrong entry, so no locks are needed.
+	class TranspositionTable
+	{
+		public:
+			TranspositionTable(size_t mb);
+			~TranspositionTable();
+			void resize(size_t mb);
+			void clear();
+			inline void new_search() { age = (age + 1) & 63; };
+			bool probe(ull key, TTData& data) const;
+			void store(ull key, int depth, Bound bound, ll score, Play move);
+			size_t size_mb() const { return nbuckets * sizeof(Bucket) >> 20; };
+		private:
+			struct Entry {
+				std::atomic<ull> key_xor_data;
+				std::atomic<ull> data;
+			};
+			struct Bucket { // slot 0: depth-preferred, slot 1: always-replace
+				Entry slot[2];
+			};
+			static ull pack(int depth, Bound bound, ll score, Play move, int age);
+			static void unpack(ull data, TTData& out);
+			unsigned char* memory;
+			Bucket* buckets; // 64-byte aligned, two buckets per cache line
+			size_t nbuckets; // power of two
+			int age;
+	};
+
+	TranspositionTable::TranspositionTable(size_t mb)
+	{
+		memory = NULL;
+		age = 0;
+		resize(mb);
+	}
+
+	TranspositionTable::~TranspositionTable()
+	{
+		delete[] memory;
+	}
+
+	void TranspositionTable::resize(size_t mb)
+	{
+		delete[] memory;
+		nbuckets = 1;
+		while (2 * nbuckets * sizeof(Bucket) <= (mb << 20)) nbuckets *= 2;
+		memory = new unsigned char[nbuckets * sizeof(Bucket) + 64];
+		buckets = (Bucket*)(((uintptr_t)memory + 63) & ~(uintptr_t)63);
+		for (size_t i = 0; i < nbuckets; ++i) new (&buckets[i]) Bucket();
+		clear();
+	}
+
+	void TranspositionTable::clear()
+	{
+		for (size_t i = 0; i < nbuckets; ++i) {
+			for (Entry& e : buckets[i].slot) {
+				e.key_xor_data.store(0, std::memory_order_relaxed);
+				e.data.store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	ull TranspositionTable::pack(int depth, Bound bound, ll score, Play move, int age)
+	{
+		score = max(-TT_SCORE_MAX, min(TT_SCORE_MAX, score));
+		return (ull)move.code | ((ull)bound << 27) | ((ull)min(depth, 63) << 29) | ((ull)age << 35)
+			| ((ull)score << 41);
+	}
+
+	void TranspositionTable::unpack(ull data, TTData& out)
+	{
+		out.move.code = data & ((1U << 27) - 1); // Play uses 27 bits
+		out.bound = (Bound)((data >> 27) & 3);
+		out.depth = (data >> 29) & 63;
+		out.age = (data >> 35) & 63;
+		out.score = (ll)data >> 41; // arithmetic shift keeps the sign
+		if (out.score >= TT_SCORE_MAX) out.score = LINF;
+		else if (out.score <= -TT_SCORE_MAX) out.score = -LINF;
+	}
+
+	bool TranspositionTable::probe(ull key, TTData& out) const
+	{
+		const Bucket& bucket = buckets[key & (nbuckets - 1)];
+		for (const Entry& e : bucket.slot) {
+			ull data = e.data.load(std::memory_order_relaxed);
+			ull check = e.key_xor_data.load(std::memory_order_relaxed);
+			if ((check ^ data) == key && data != 0) {
+				unpack(data, out);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void TranspositionTable::store(ull key, int depth, Bound bound, ll score, Play move)
+	{
+		Bucket& bucket = buckets[key & (nbuckets - 1)];
+		Entry& deep = bucket.slot[0];
+		ull old = deep.data.load(std::memory_order_relaxed);
+		TTData old_data;
+		unpack(old, old_data);
+		bool same_key = (deep.key_xor_data.load(std::memory_order_relaxed) ^ old) == key;
+		Entry& e = (old == 0 || same_key || depth >= old_data.depth || old_data.age != age)
+			? deep : bucket.slot[1];
+		ull data = pack(depth, bound, score, move, age);
+		e.key_xor_data.store(key ^ data, std::memory_order_relaxed);
+		e.data.store(data, std::memory_order_relaxed);
+	}
+
+}
+
+#endif
@@ -0,0 +1,543 @@
+#ifndef HIVE_UHP_H
+#define HIVE_UHP_H
+
+#include "Minimax.h"
+#include "MCTS.h"
+#include <sstream>
+#include <string>
+
+// Universal Hive Protocol (https://github.com/jonthysell/Mzinga/wiki/UniversalHiveProtocol),
+// base game only. Pieces are named like wA1, bQ; positions are given relative to a piece
+// already in play: "wS1-" east of it, "/wS1" south-west of it, "wS1" on top of it.
+namespace UHP
+{
+	using namespace AI;
+	using namespace std;
+
+	enum Searcher { MinimaxSearcher, MCTSSearcher };
+
+	const string ENGINE_ID = "HiveAI v1.0";
+	const string PIECE_CHARS = "AQBGS"; // indexed by Piece
+	const string COLOR_CHARS = "bw"; // indexed by Color
+	const array<string,2> COLOR_NAMES = {{ "Black", "White" }};
+	const array<string,2> SEARCHER_NAMES = {{ "Minimax", "MCTS" }};
+	const array<string,2> PARALLELISM_NAMES = {{ "Tree", "Root" }}; // MCTS::root_parallel
+	// Marks around a reference piece, indexed by the dirs index from the reference to the
+	// target (NE, E, SE as suffixes, SW, W, NW as prefixes): UHP is pointy-topped and this
+	// grid is flat-topped, so UHP directions are this grid's turned 30 degrees clockwise.
+	const string DIR_MARKS = "/-\\/-\\";
+
+	int parse_time(const string& s) // hh:mm:ss in milliseconds, -1 if malformed
+	{
+		int h, m, sec;
+		char end;
+		if (sscanf(s.c_str(), "%d:%d:%d%c", &h, &m, &sec, &end) != 3 || h < 0 || m < 0 || sec < 0) return -1;
+		return ((h * 60 + m) * 60 + sec) * 1000;
+	}
+
+	class Engine
+	{
+		public:
+			Engine();
+			void run(istream& in, ostream& out); // reads commands until "exit" or end of input
+			bool execute(const string& line, ostream& out); // false on "exit"
+			void new_game();
+			bool play(const string& move, string& error);
+			void undo();
+			string game_string();
+			string game_state();
+			string valid_moves();
+			string move_string(Play play); // play must be valid for turn
+			bool parse_move(const string& s, Play& play, string& error);
+			Play best_move(const SearchLimits& limits);
+			Game game;
+			Color turn; // side to move
+			vector<Play> history; // NOPLAY: pass
+			vector<string> history_strings;
+			Searcher searcher;
+		private:
+			MCTS::Node* tree; // MCTS node of the current position, NULL if it is not in the tree
+			Play last_best; // our last bestmove, pondering starts once it is played
+			bool pondered; // the opponent played the reply Minimax pondered on, bestmove finishes that search
+			void stop_pondering();
+			string piece_name(Color color, Piece piece, int number) const;
+			bool parse_piece(const string& s, Color& color, Piece& piece, int& number) const;
+			Hex find_piece(Color color, Piece piece, int number); // Hex() if not in play
+			Hex top(int c); // topmost piece at cell c, Hex() if empty
+			bool is_surrounded(Color color);
+			string option_string(const string& name);
+			bool set_option(const string& name, const string& value);
+			array<array<signed char,NCELLS>,2> number; // layer, cell -> piece number, 0 if empty
+			array<array<int,NPIECETYPES>,2> placed; // color, piece -> pieces put so far
+	};
+
+	Engine::Engine()
+	{
+		turn = Color::White;
+		searcher = MinimaxSearcher;
+		tree = NULL;
+		last_best = NOPLAY;
+		pondered = false;
+		for (auto& layer : number) layer.fill(0);
+		for (auto& color : placed) color.fill(0);
+	}
+
+	string Engine::piece_name(Color color, Piece piece, int number) const
+	{
+		string name = string(1, COLOR_CHARS[color]) + PIECE_CHARS[piece];
+		if (piece != Piece::Bee) name += to_string(number);
+		return name;
+	}
+
+	bool Engine::parse_piece(const string& s, Color& color, Piece& piece, int& number) const
+	{
+		if (s.size() < 2 || COLOR_CHARS.find(s[0]) == string::npos || PIECE_CHARS.find(s[1]) == string::npos) {
+			return false;
+		}
+		color = (Color)COLOR_CHARS.find(s[0]);
+		piece = (Piece)PIECE_CHARS.find(s[1]);
+		if (piece == Piece::Bee) {
+			number = 1;
+			return s.size() == 2;
+		}
+		if (s.size() != 3 || s[2] < '1' || s[2] > '9') return false;
+		number = s[2] - '0';
+		return true;
+	}
+
+	Hex Engine::find_piece(Color color, Piece piece, int n)
+	{
+		for (Hex h : game.positions[color][piece]) {
+			if (number[h.layer][cell_index(h.x, h.y)] == n) return h;
+		}
+		return Hex();
+	}
+
+	Hex Engine::top(int c)
+	{
+		int x = cell_x(c), y = cell_y(c);
+		if (game.grid[x][y][1].piece != Piece::NoPiece) return game.grid[x][y][1];
+		return game.grid[x][y][0];
+	}
+
+	bool Engine::is_surrounded(Color color)
+	{
+		return !game.positions[color][Piece::Bee].empty()
+			&& game.surrounding_cnt(game.positions[color][Piece::Bee][0]) == 6;
+	}
+
+	void Engine::stop_pondering()
+	{
+		Minimax::stop_pondering();
+		MCTS::stop_pondering();
+		pondered = false;
+	}
+
+	void Engine::new_game()
+	{
+		stop_pondering();
+		while (!history.empty()) undo();
+		turn = Color::White;
+	}
+
+	string Engine::game_state()
+	{
+		if (history.empty()) return "NotStarted";
+		bool black_lost = is_surrounded(Color::Black), white_lost = is_surrounded(Color::White);
+		if (black_lost && white_lost) return "Draw";
+		if (white_lost) return "BlackWins";
+		if (black_lost) return "WhiteWins";
+		return "InProgress";
+	}
+
+	string Engine::game_string()
+	{
+		string s = "Base;" + game_state() + ";" + COLOR_NAMES[turn] + "[" + to_string(history.size() / 2 + 1) + "]";
+		for (const string& move : history_strings) s += ";" + move;
+		return s;
+	}
+
+	string Engine::move_string(Play play)
+	{
+		if (play == NOPLAY) return "pass";
+		Hex to = play.h2();
+		int c = cell_index(to.x, to.y);
+		string name;
+		if (play.type() == PlayType::Put) {
+			name = piece_name(turn, play.piece(), placed[turn][play.piece()] + 1);
+			if (!game.occupied[0].any()) return name; // first piece of the game
+		}
+		else {
+			name = piece_name(turn, play.piece(), number[play.from_layer()][play.from()]);
+		}
+		if (to.layer == 1) { // climbing: on top of the piece there
+			Hex below = game.grid[to.x][to.y][0];
+			return name + " " + piece_name(below.color, below.piece, number[0][c]);
+		}
+		for (int dir = 0; dir < 6; ++dir) {
+			int n = NEIGHBOUR[c][dir];
+			if (n < 0) continue;
+			Hex ref = top(n);
+			if (play.type() == PlayType::Move && n == play.from()) { // the moving piece can not be the reference
+				ref = play.from_layer() == 1 ? game.grid[cell_x(n)][cell_y(n)][0] : Hex();
+			}
+			if (ref.piece == Piece::NoPiece) continue;
+			string ref_name = piece_name(ref.color, ref.piece, number[ref.layer][n]);
+			int ref_dir = (dir + 3) % 6; // from the reference to the target
+			if (ref_dir < 3) return name + " " + ref_name + DIR_MARKS[ref_dir];
+			return name + " " + DIR_MARKS[ref_dir] + ref_name;
+		}
+		assert(false); // a valid play always touches the hive
+		return name;
+	}
+
+	bool Engine::parse_move(const string& s, Play& play, string& error)
+	{
+		istringstream in(s);
+		string piece_str, pos_str, extra;
+		in >> piece_str >> pos_str >> extra;
+		if (piece_str == "pass" && pos_str.empty()) {
+			play = NOPLAY;
+			return true;
+		}
+		Color color;
+		Piece piece;
+		int n;
+		if (!parse_piece(piece_str, color, piece, n) || !extra.empty()) {
+			error = "Unable to parse '" + s + "'";
+			return false;
+		}
+		if (color != turn) {
+			error = "It is " + COLOR_NAMES[turn] + "'s turn";
+			return false;
+		}
+		Hex from = find_piece(color, piece, n);
+		if (from.piece == Piece::NoPiece && n != placed[color][piece] + 1) {
+			error = "Pieces must be put in order, " + piece_name(color, piece, placed[color][piece] + 1) + " is next";
+			return false;
+		}
+
+		Hex to;
+		if (pos_str.empty()) {
+			if (game.occupied[0].any()) {
+				error = "Missing the position of '" + s + "'";
+				return false;
+			}
+			to = Hex(0, GSIDE/2, GSIDE/2); // see Game::spawn_cells
+		}
+		else {
+			int dir = -1;
+			string ref_str = pos_str;
+			size_t mark = DIR_MARKS.find(pos_str[0]);
+			if (mark != string::npos) {
+				dir = 3 + mark % 3;
+				ref_str = pos_str.substr(1);
+			}
+			else if ((mark = DIR_MARKS.find(pos_str.back())) != string::npos) {
+				dir = mark % 3;
+				ref_str.pop_back();
+			}
+			Color ref_color;
+			Piece ref_piece;
+			int ref_n;
+			Hex ref;
+			if (parse_piece(ref_str, ref_color, ref_piece, ref_n)) ref = find_piece(ref_color, ref_piece, ref_n);
+			if (ref.piece == Piece::NoPiece) {
+				error = "'" + ref_str + "' is not in play";
+				return false;
+			}
+			int c = cell_index(ref.x, ref.y);
+			if (dir >= 0) c = NEIGHBOUR[c][dir];
+			if (c < 0) {
+				error = "Out of the board";
+				return false;
+			}
+			to = Hex(game.occupied[0].test(c) ? 1 : 0, cell_x(c), cell_y(c));
+			if (game.occupied[1].test(c)) {
+				error = "Stacks higher than two pieces are not supported";
+				return false;
+			}
+		}
+		play = from.piece == Piece::NoPiece ? play_put(to, piece) : play_move(from, to, piece);
+		return true;
+	}
+
+	bool Engine::play(const string& move, string& error)
+	{
+		if (game_state() != "NotStarted" && game_state() != "InProgress") {
+			error = "The game is over";
+			return false;
+		}
+		Play play;
+		if (!parse_move(move, play, error)) return false;
+
+		MoveList plays;
+		gen_plays(game, turn, plays);
+		if (play == NOPLAY ? !plays.empty() : find(plays.begin(), plays.end(), play) == plays.end()) {
+			error = "'" + move + "' is not a valid move";
+			return false;
+		}
+
+		history_strings.push_back(move_string(play));
+		history.push_back(play);
+		if (play.type() == PlayType::Put) {
+			number[0][play.to()] = ++placed[turn][play.piece()];
+		}
+		else if (play.type() == PlayType::Move) {
+			number[play.to_layer()][play.to()] = number[play.from_layer()][play.from()];
+			number[play.from_layer()][play.from()] = 0;
+		}
+		if (play != NOPLAY) game.make_move(play, turn);
+		turn = (Color)!turn;
+		if (pondered) stop_pondering(); // bestmove was not asked after the hit
+		pondered = Minimax::ponder_hit(play);
+		tree = MCTS::ponder_reply(tree, play);
+		bool ours = (last_best != NOPLAY && play == last_best); // a pass is never pondered on
+		if (ours && searcher == MinimaxSearcher && Minimax::ponder) Minimax::start_pondering(game, turn);
+		if (ours && searcher == MCTSSearcher && MCTS::ponder) MCTS::start_pondering(tree, game);
+		last_best = NOPLAY;
+		return true;
+	}
+
+	void Engine::undo()
+	{
+		assert(!history.empty());
+		stop_pondering();
+		Play play = history.back();
+		turn = (Color)!turn;
+		if (play != NOPLAY) game.unmake_move();
+		if (play.type() == PlayType::Put) {
+			number[0][play.to()] = 0;
+			--placed[turn][play.piece()];
+		}
+		else if (play.type() == PlayType::Move) {
+			number[play.from_layer()][play.from()] = number[play.to_layer()][play.to()];
+			number[play.to_layer()][play.to()] = 0;
+		}
+		history.pop_back();
+		history_strings.pop_back();
+		tree = NULL;
+	}
+
+	string Engine::valid_moves()
+	{
+		MoveList plays;
+		gen_plays(game, turn, plays);
+		if (plays.empty()) return "pass";
+		string s;
+		for (Play play : plays) s += (s.empty() ? "" : ";") + move_string(play);
+		return s;
+	}
+
+	Play Engine::best_move(const SearchLimits& limits) // MCTS takes no depth limit, its nodes are playouts
+	{
+		if (searcher == MCTSSearcher) {
+			tree = (tree != NULL ? MCTS::keep_subtree(tree) : MCTS::new_tree(turn));
+			MCTS::Node* best = tree->search(game, limits);
+			last_best = (best != NULL ? best->play : NOPLAY);
+		}
+		else if (pondered) {
+			pondered = false;
+			last_best = Minimax::finish_pondering(limits);
+		}
+		else last_best = Minimax::search(game, turn, limits); // stops a ponder search that missed
+		return last_best;
+	}
+
+	string Engine::option_string(const string& name)
+	{
+		if (name == "Searcher") {
+			return name + ";enum;" + SEARCHER_NAMES[searcher] + ";" + SEARCHER_NAMES[0] + ";" + SEARCHER_NAMES[0] + ";" + SEARCHER_NAMES[1];
+		}
+		if (name == "MCTSParallelism") {
+			return name + ";enum;" + PARALLELISM_NAMES[MCTS::root_parallel] + ";" + PARALLELISM_NAMES[0] + ";"
+				+ PARALLELISM_NAMES[0] + ";" + PARALLELISM_NAMES[1];
+		}
+		if (name == "Threads") {
+			return name + ";int;" + to_string(AI::threads) + ";" + to_string(max(1U, thread::hardware_concurrency())) + ";1;256";
+		}
+		if (name == "NullMove") {
+			return name + ";bool;" + (Minimax::null_move ? "True" : "False") + ";True";
+		}
+		if (name == "LMR") {
+			return name + ";bool;" + (Minimax::lmr ? "True" : "False") + ";True";
+		}
+		if (name == "MCTSRave") {
+			return name + ";bool;" + (MCTS::rave ? "True" : "False") + ";False";
+		}
+		if (name == "Ponder") {
+			return name + ";bool;" + (Minimax::ponder ? "True" : "False") + ";False";
+		}
+		if (name == "PlayoutEpsilon") {
+			return name + ";double;" + to_string((double)Playout::epsilon) + ";0;0;1";
+		}
+		if (name == "TTSizeMB") {
+			return name + ";int;" + to_string(Minimax::TT.size_mb()) + ";" + to_string(TT_MB) + ";1;4096";
+		}
+		return "";
+	}
+
+	bool Engine::set_option(const string& name, const string& value)
+	{
+		stop_pondering(); // no option changes under a running search
+		if (name == "Searcher") {
+			if (value == SEARCHER_NAMES[0]) searcher = MinimaxSearcher;
+			else if (value == SEARCHER_NAMES[1]) searcher = MCTSSearcher;
+			else return false;
+			return true;
+		}
+		if (name == "MCTSParallelism") {
+			if (value == PARALLELISM_NAMES[0]) MCTS::root_parallel = false;
+			else if (value == PARALLELISM_NAMES[1]) MCTS::root_parallel = true;
+			else return false;
+			return true;
+		}
+		if (name == "Threads") {
+			int n = atoi(value.c_str());
+			if (n < 1 || n > 256) return false;
+			AI::threads = n;
+			return true;
+		}
+		if (name == "NullMove" || name == "LMR") {
+			bool& flag = (name == "NullMove" ? Minimax::null_move : Minimax::lmr);
+			if (value == "True") flag = true;
+			else if (value == "False") flag = false;
+			else return false;
+			return true;
+		}
+		if (name == "MCTSRave") {
+			if (value == "True") MCTS::rave = true;
+			else if (value == "False") MCTS::rave = false;
+			else return false;
+			return true;
+		}
+		if (name == "Ponder") { // both searchers
+			if (value == "True") Minimax::ponder = MCTS::ponder = true;
+			else if (value == "False") Minimax::ponder = MCTS::ponder = false;
+			else return false;
+			return true;
+		}
+		if (name == "PlayoutEpsilon") {
+			char* end;
+			double epsilon = strtod(value.c_str(), &end);
+			if (value.empty() || *end != '\0' || epsilon < 0 || epsilon > 1) return false;
+			Playout::epsilon = epsilon;
+			return true;
+		}
+		if (name == "TTSizeMB") {
+			int mb = atoi(value.c_str());
+			if (mb < 1 || mb > 4096) return false;
+			Minimax::TT.resize(mb);
+			return true;
+		}
+		return false;
+	}
+
+	bool Engine::execute(const string& line, ostream& out)
+	{
+		istringstream in(line);
+		string command, arg;
+		in >> command;
+		getline(in >> ws, arg);
+
+		if (command == "exit") {
+			return false;
+		}
+		else if (command == "info") {
+			out << "id " << ENGINE_ID << endl;
+		}
+		else if (command == "newgame") {
+			new_game();
+			if (!arg.empty() && arg != "Base") {
+				// GameString: GameType;GameState;Turn;Move1;Move2...
+				vector<string> fields;
+				istringstream game_str(arg);
+				for (string field; getline(game_str, field, ';'); ) fields.push_back(field);
+				string error;
+				if (fields[0] != "Base") error = "Unsupported game type '" + fields[0] + "'";
+				for (size_t i = 3; i < fields.size() && error.empty(); ++i) play(fields[i], error);
+				if (!error.empty()) {
+					new_game();
+					out << "err " << error << endl << "ok" << endl;
+					return true;
+				}
+			}
+			out << game_string() << endl;
+		}
+		else if (command == "play" || command == "pass") {
+			string error;
+			if (play(command == "pass" ? command : arg, error)) out << game_string() << endl;
+			else out << "invalidmove " << error << endl;
+		}
+		else if (command == "validmoves") {
+			out << valid_moves() << endl;
+		}
+		else if (command == "bestmove") {
+			istringstream args(arg);
+			string kind, limit, increment;
+			args >> kind >> limit >> increment;
+			SearchLimits limits;
+			if (kind == "time") limits.move_ms = parse_time(limit);
+			else if (kind == "clock") limits.clock_ms = parse_time(limit), limits.inc_ms = (increment.empty() ? 0 : parse_time(increment));
+			else if (kind == "depth" && searcher == MinimaxSearcher) limits.depth = atoi(limit.c_str());
+			else if (kind == "nodes") limits.nodes = atoll(limit.c_str());
+			if (game_state() != "NotStarted" && game_state() != "InProgress") {
+				out << "err The game is over" << endl;
+			}
+			else if (limits.move_ms > 0 || (limits.clock_ms > 0 && limits.inc_ms >= 0) || limits.depth > 0 || limits.nodes > 0) {
+				out << move_string(best_move(limits)) << endl;
+			}
+			else {
+				out << "err Usage: bestmove time hh:mm:ss | bestmove clock hh:mm:ss [increment hh:mm:ss]"
+					<< " | bestmove depth n | bestmove nodes n (depth: Minimax only, nodes: playouts for MCTS)" << endl;
+			}
+		}
+		else if (command == "undo") {
+			int n = arg.empty() ? 1 : atoi(arg.c_str());
+			if (n < 1 || n > (int)history.size()) {
+				out << "err Unable to undo " << arg << " moves" << endl;
+			}
+			else {
+				while (n--) undo();
+				out << game_string() << endl;
+			}
+		}
+		else if (command == "options") {
+			istringstream args(arg);
+			string action, name, value;
+			args >> action >> name >> value;
+			if (action.empty()) {
+				for (string name : { "Searcher", "Threads", "NullMove", "LMR", "MCTSParallelism", "MCTSRave", "Ponder", "PlayoutEpsilon", "TTSizeMB" }) out << option_string(name) << endl;
+			}
+			else if (action == "get" && !option_string(name).empty()) {
+				out << option_string(name) << endl;
+			}
+			else if (action == "set" && set_option(name, value)) {
+				out << option_string(name) << endl;
+			}
+			else {
+				out << "err Invalid option command '" << arg << "'" << endl;
+			}
+		}
+		else {
+			out << "err Invalid command '" << command << "'" << endl;
+		}
+		out << "ok" << endl;
+		return true;
+	}
+
+	void Engine::run(istream& in, ostream& out)
+	{
+		execute("info", out);
+		string line;
+		while (getline(in, line)) {
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (line.empty()) continue;
+			if (!execute(line, out)) break;
+		}
+		stop_pondering();
+	}
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+// Lazy SMP scaling benchmark: time to a fixed depth and depth reached in a fixed time,
+// from 1 thread up to the given count. Also MCTS playouts per second in the same time, and
+// depth and nodes on 1 thread with the Minimax pruning switched on and off.
+// Usage: bench [max threads] [depth] [milliseconds per position]
+
+#include "UHP.h"
+
+using namespace std;
+using namespace Hive;
+using namespace AI;
+
+const vector<string> POSITIONS = { // UHP GameStrings
+	"Base;InProgress;White[8];wB1;bA1 \\wB1;wQ wB1-;bQ -bA1;wQ wB1/;bA2 /bQ;wG1 wQ/;bA2 wQ-;wB1 /bA1;bQ \\bA1;"
+		"wG1 bA2\\;bG1 \\bQ;wS1 wG1-;bB1 -bG1",
+	"Base;InProgress;White[10];wS1;bB1 wS1\\;wA1 \\wS1;bS1 bB1-;wG1 -wA1;bQ /bB1;wQ -wG1;bA1 -bQ;wA2 \\wG1;"
+		"bS2 bS1/;wA2 wA1/;bA1 -bS2;wA2 /wS1;bS1 bS2/;wA2 /wA1;bA2 /bQ;wQ /wG1;bA2 /wS1",
+	"Base;InProgress;White[12];wA1;bB1 wA1/;wG1 wA1\\;bB2 bB1/;wQ wG1\\;bS1 bB2/;wG2 /wQ;bQ bB1-;wB1 wQ-;bQ wG1/;"
+		"wB2 /wG2;bS1 bQ-;wA2 -wG2;bB2 bB1;wB1 wG2-;bB2 -bB1;wA1 wB2\\;bS2 \\bB2;wA1 \\wA2;bS2 /bB1;wA3 /wA1;bS2 -wA1",
+	"Base;InProgress;White[14];wQ;bA1 /wQ;wQ bA1-;bB1 /bA1;wB1 wQ/;bQ \\bA1;wA1 wB1/;bB2 /bQ;wA1 wQ\\;bB2 -bQ;"
+		"wA1 bB1\\;bG1 -bB1;wA1 /bG1;bB2 \\bG1;wA1 -bB2;bG2 bB1\\;wA1 \\bB2;bQ -bA1;wB2 wB1-;bG1 /wQ;wA1 \\wB1;"
+		"bB1 bG1;wA1 -bB2;bB1 bG1-;wA1 \\bA1;bB2 bQ",
+};
+
+int main(int argc, char *argv[])
+{
+	srand(0);
+	precompute_global_variables(); // NEVER remove this
+
+	int max_threads = argc > 1 ? atoi(argv[1]) : max(1U, thread::hardware_concurrency());
+	int depth = argc > 2 ? atoi(argv[2]) : 3;
+	int ms = argc > 3 ? atoi(argv[3]) : 2000;
+
+	vector<int> counts;
+	for (int t = 1; t < max_threads; t *= 2) counts.push_back(t);
+	counts.push_back(max_threads);
+
+	double base_ms = 0;
+	cout << "threads  time to depth " << depth << " (ms)  speedup  nodes/s  avg depth in " << ms << " ms  first-move cutoffs  MCTS playouts/s" << endl;
+	for (int t : counts) {
+		AI::threads = t;
+		double total_ms = 0, total_nodes = 0, total_depth = 0, total_playouts = 0, cutoffs = 0, first_cutoffs = 0;
+		for (const string& position : POSITIONS) {
+			UHP::Engine engine;
+			ostringstream out;
+			engine.execute("newgame " + position, out);
+
+			Minimax::TT.clear();
+			Minimax::search(engine.game, engine.turn, IINF, depth);
+			total_ms += Minimax::info.ms;
+			total_nodes += Minimax::info.nodes;
+
+			Minimax::TT.clear();
+			Minimax::search(engine.game, engine.turn, ms);
+			total_depth += Minimax::info.depth;
+			cutoffs += Minimax::info.cutoffs;
+			first_cutoffs += Minimax::info.first_cutoffs;
+
+			MCTS::new_tree(engine.turn)->search(engine.game, ms);
+			total_playouts += MCTS::playouts_per_sec;
+		}
+		if (t == 1) base_ms = total_ms;
+		cout << t << "  " << total_ms << "  " << base_ms / max(total_ms, 1.0) << "  "
+			<< (ull)(total_nodes * 1000 / max(total_ms, 1.0)) << "  " << total_depth / POSITIONS.size() << "  "
+			<< first_cutoffs / max(cutoffs, 1.0) << "  " << (ull)(total_playouts / POSITIONS.size()) << endl;
+	}
+
+	AI::threads = 1;
+	cout << endl << "null move  LMR  avg depth in " << ms << " ms  nodes  null cutoffs  LMR re-searches" << endl;
+	for (int features = 3; features >= 0; --features) {
+		Minimax::null_move = features & 2;
+		Minimax::lmr = features & 1;
+		double total_depth = 0, total_nodes = 0, null_cutoffs = 0, lmr_researches = 0;
+		for (const string& position : POSITIONS) {
+			UHP::Engine engine;
+			ostringstream out;
+			engine.execute("newgame " + position, out);
+
+			Minimax::TT.clear();
+			Minimax::search(engine.game, engine.turn, ms);
+			total_depth += Minimax::info.depth;
+			total_nodes += Minimax::info.nodes;
+			null_cutoffs += Minimax::info.null_cutoffs;
+			lmr_researches += Minimax::info.lmr_researches;
+		}
+		cout << (Minimax::null_move ? "on" : "off") << "  " << (Minimax::lmr ? "on" : "off") << "  "
+			<< total_depth / POSITIONS.size() << "  " << (ull)total_nodes << "  " << (ull)null_cutoffs << "  "
+			<< (ull)lmr_researches << endl;
+	}
+	return 0;
+}
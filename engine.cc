@@ -0,0 +1,19 @@
+// Headless engine speaking the Universal Hive Protocol over stdin / stdout
+// Usage: hive_engine [evaluation weights file]
+#include "UHP.h"
+
+int main(int argc, char *argv[])
+{
+	std::ios::sync_with_stdio(false);
+	srand(time(0)); // required to work with random numbers
+	Hive::precompute_global_variables(); // NEVER remove this
+	if (argc > 1 && !AI::load_weights(argv[1])) { // evaluation weights file
+		std::cerr << "unable to load weights from " << argv[1] << std::endl;
+		return 1;
+	}
+	UHP::Engine engine;
+	engine.run(std::cin, std::cout);
+	unsigned long long hits = Minimax::ponder_hits + MCTS::ponder_hits, misses = Minimax::ponder_misses + MCTS::ponder_misses;
+	if (hits + misses > 0) std::cerr << "ponder hits: " << hits << " / " << hits + misses << std::endl;
+	return 0;
+}
@@ -0,0 +1,70 @@
+// Headless check of the node limits of both searchers.
+// Usage: limits [max threads]
+// Minimax with "nodes n" must search n nodes on 1 thread, completing depth 1 and reporting
+// it, and at most twice as many on more threads, which share the nodes as the scheduler lets
+// them. MCTS must run n playouts, plus at most one per extra thread.
+
+#include "UHP.h"
+
+using namespace std;
+using namespace Hive;
+using namespace AI;
+
+const string POSITION = "Base;InProgress;White[3];wS1;bG1 -wS1;wQ wS1/;bQ /bG1";
+const vector<ull> NODES = { 100, 1025, 2048, 5000 };
+
+bool check(const string& what, bool ok)
+{
+	cout << what << (ok ? " ok" : " FAILED") << endl;
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	srand(0);
+	precompute_global_variables(); // NEVER remove this
+
+	int max_threads = argc > 1 ? atoi(argv[1]) : max(1U, thread::hardware_concurrency());
+	UHP::Engine engine;
+	ostringstream out;
+	engine.execute("newgame " + POSITION, out);
+	if (out.str().compare(0, 4, "err ") == 0) {
+		cerr << out.str();
+		return 1;
+	}
+
+	int failures = 0;
+	for (int t : { 1, max_threads }) {
+		threads = t;
+		for (ull n : NODES) {
+			ull reported = 0;
+			SearchLimits limits;
+			limits.nodes = n;
+			limits.progress = [&reported](const Progress& p) { reported = p.nodes; };
+			Minimax::TT.clear();
+			Minimax::search(engine.game, engine.turn, limits);
+			ostringstream what;
+			what << "Minimax " << t << " threads, nodes " << n << ": depth " << Minimax::info.depth
+				<< ", " << Minimax::info.nodes << " nodes, " << reported << " reported";
+			bool ok = (t == 1 ? Minimax::info.depth >= 1 && reported > 0 && Minimax::info.nodes == n
+				: Minimax::info.nodes >= n && Minimax::info.nodes <= 2 * n);
+			failures += !check(what.str(), ok);
+		}
+		for (ull n : NODES) {
+			SearchLimits limits;
+			limits.nodes = n;
+			MCTS::new_tree(engine.turn)->search(engine.game, limits);
+			ostringstream what;
+			what << "MCTS " << t << " threads, nodes " << n << ": " << MCTS::playouts << " playouts";
+			failures += !check(what.str(), MCTS::playouts >= n && MCTS::playouts < n + t);
+		}
+		if (max_threads == 1) break;
+	}
+
+	if (failures > 0) {
+		cout << "FAILED: " << failures << " checks" << endl;
+		return 1;
+	}
+	cout << "All limits honoured" << endl;
+	return 0;
+}
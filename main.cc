@@ -4,6 +4,7 @@
 #include "AI.h"
 #include "Minimax.h"
 #include "MCTS.h"
+#include "AsyncSearch.h"
 #include <stdlib.h>
 #include <time.h>
 #include <iostream>
@@ -11,6 +12,7 @@ using namespace Hive;
 using namespace std;
 
 const int WIDTH = 700, HEIGHT = 700;
+const int FPS = 60; // the window is drawn at this rate, also while the AI thinks
 
 SDL_Renderer* renderer = NULL;
 SDL_Surface* hexgrid_img = NULL;
@@ -74,6 +76,20 @@ void draw_hexgrid(Game& game)
     }
 }
 
+// Marks where the best play found so far by the AI goes, and where it comes from
+void draw_progress(const AI::Progress& progress)
+{
+    if (progress.best_play == AI::NOPLAY) return;
+    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 100);
+    vector<int> cells(1, progress.best_play.to());
+    if (progress.best_play.type() == AI::PlayType::Move) cells.push_back(progress.best_play.from());
+    for (int c : cells) {
+        int x = cell_x(c), y = cell_y(c);
+        draw_circle(grid_to_screen_x(x) + hexgrid_img->w/2, grid_to_screen_y(x, y) + hexgrid_img->h/2, hexgrid_img->h/4);
+    }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+}
+
 void draw_piece(int piece)
 {  
     int x = mouse_x - hexgrid_img->w/2;
@@ -120,6 +136,7 @@ int main(int argc, char *argv[])
 {
     srand(time(0)); // required to work with random numbers
     precompute_global_variables(); // NEVER remove this
+    AI::load_weights(argc > 1 ? argv[1] : "weights.txt"); // the defaults stay if there is no such file
     SDL_Init(SDL_INIT_EVERYTHING);
 
     SDL_Window *window = SDL_CreateWindow("HiveAI", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WIDTH, HEIGHT, SDL_WINDOW_ALLOW_HIGHDPI);
@@ -151,40 +168,67 @@ int main(int argc, char *argv[])
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
 #if USE_MCTS
-    MCTS::Node* mcts = new MCTS::Node;
-    mcts->play = AI::play_info_null();
-    mcts->color = ia_color;
+    MCTS::Node* mcts = NULL; // after the last AI play, its children are the player's replies
+    MCTS::ponder = PONDER;
+#else
+    Minimax::ponder = PONDER;
 #endif
 
+    // The AI turn runs in the background, the loop keeps drawing and shows its progress.
+    // Space makes the AI play its best play so far.
+    AI::AsyncSearch ai_turn;
+    AI::SearchLimits limits;
+    limits.move_ms = TLE;
+
     Color winner = Color::NoColor;
     SDL_Event event;
-    while (true) {
+    bool quit = false;
+    while (!quit) {
+        Uint32 frame0 = SDL_GetTicks();
+        if (ai_turn.done()) {
+            AI::Play play = ai_turn.play();
+            if (play != AI::NOPLAY) {
+                AI::do_play(game, play, ia_color);
+#if USE_MCTS
+                mcts = mcts->find_child(play);
+                if (MCTS::ponder) MCTS::start_pondering(mcts, game);
+#else
+                if (Minimax::ponder) Minimax::start_pondering(game, player_color);
+#endif
+            }
+            if (DEBUG) cout << "IA turn - END" << endl;
+            winner = game.winner();
+            if (winner != Color::NoColor) finish_game(game, winner);
+        }
+
         if (winner == Color::NoColor) {
             SDL_GetMouseState(&mouse_x, &mouse_y);
-            if (SDL_PollEvent(&event)) {
-                AI::PlayInfo player_play = AI::play_info_null();
+            while (SDL_PollEvent(&event)) {
+                AI::Play player_play = AI::NOPLAY;
                 int x = screen_to_grid_x(mouse_x);
                 int y = screen_to_grid_y(x, mouse_y);
                 if (SDL_QUIT == event.type) {
+                    quit = true;
                     break;
                 }
                 else if (SDL_MOUSEBUTTONUP == event.type) {
                     switch (event.button.button) {
                         case SDL_BUTTON_LEFT: {
                             bool valid = false;
+                            if (ai_turn.running()) break; // not the player's turn
                             if (selected_hex.color == Color::NoColor) {
                                 valid = game.put_piece(x, y, player_color, (Piece)selected_piece);
-                                if (valid) player_play = AI::play_info_put(0, Hex(0, x, y), (Piece)selected_piece);
+                                if (valid) player_play = AI::play_put(Hex(0, x, y), (Piece)selected_piece);
                             }
                             else {
                                 // int layer = (selected_hex.piece == Piece::Beetle && game.grid[x][y][0].piece != Piece::NoPiece ? 1 : 0);
                                 // valid = game.move_piece(x, y, selected_hex, layer);
                                 if (selected_hex.color == player_color) {
                                     valid = game.move_piece(x, y, selected_hex);
-                                    if (valid) player_play = AI::play_info_move(0, selected_hex, Hex(0, x, y), selected_hex.piece);
+                                    if (valid) player_play = AI::play_move(selected_hex, Hex(0, x, y), selected_hex.piece);
                                     if (!valid && selected_hex.piece == Piece::Beetle) {
                                         valid = game.move_piece(x, y, selected_hex, 1);
-                                        if (valid) player_play = AI::play_info_move(0, selected_hex, Hex(1, x, y), selected_hex.piece);
+                                        if (valid) player_play = AI::play_move(selected_hex, Hex(1, x, y), selected_hex.piece);
                                     }
                                 }
 
@@ -198,32 +242,22 @@ int main(int argc, char *argv[])
                             if (valid && winner == Color::NoColor) {
                                 if (DEBUG) cout << "IA turn:" << endl;
 
+                                Game position = game; // the search has its own copy, game is drawn meanwhile
 #if USE_MCTS
-                                mcts = new MCTS::Node;
-                                mcts->play = AI::play_info_null();
-                                mcts->color = ia_color;
-
-
-                                // for (MCTS::Node* child : mcts->childs) {
-                                //     if (child->play == player_play) {
-                                //         mcts = child;
-                                //         break;
-                                //     }
-                                // }
-                                // mcts->parent = NULL;
-                                // mcts->play = AI::play_info_null();
-                                // D(mcts->color) << endl;
-
-
-                                mcts = mcts->play_hive(game);
+                                // keep what the last search (and the pondering since) learnt about the reply
+                                MCTS::Node* reply = MCTS::ponder_reply(mcts, player_play);
+                                mcts = (reply != NULL ? MCTS::keep_subtree(reply) : MCTS::new_tree(ia_color));
+                                if (DEBUG) D(MCTS::reused_visits) << endl;
+                                MCTS::Node* root = mcts;
+                                ai_turn.start([root, position](const AI::SearchLimits& limits) mutable {
+                                    MCTS::Node* best = root->search(position, limits);
+                                    return best != NULL ? best->play : AI::NOPLAY;
+                                }, limits);
 #else
-                                Minimax::play_hive(game);
+                                ai_turn.start([player_play, position](const AI::SearchLimits& limits) mutable {
+                                    return Minimax::choose_play(position, player_play, limits);
+                                }, limits);
 #endif
-                                
-
-                                if (DEBUG) cout << "IA turn - END" << endl;
-                                winner = game.winner();
-                                if (winner != Color::NoColor) finish_game(game, winner);
                             }
                             break;
                         }
@@ -241,6 +275,7 @@ int main(int argc, char *argv[])
                     if (c >= '1' && c <= '5') {
                         selected_piece = c - '0' - 1;
                     }
+                    if (c == ' ' && ai_turn.running()) ai_turn.cancel();
 
                     // DEBUG:
                     if (DEBUG && c == 'd') {
@@ -290,11 +325,31 @@ int main(int argc, char *argv[])
             }
         }
 
-        SDL_Delay(1);
+        if (ai_turn.running()) {
+            AI::Progress progress = ai_turn.progress();
+            draw_progress(progress);
+            string title = "HiveAI - thinking: depth " + to_string(progress.depth) + ", " + to_string(progress.nodes)
+                + (USE_MCTS ? " playouts" : " nodes") + ", " + to_string(progress.ms) + " ms (space: play now)";
+            SDL_SetWindowTitle(window, title.c_str());
+        }
+        else {
+            SDL_SetWindowTitle(window, "HiveAI");
+        }
+
         SDL_RenderPresent(renderer);
         SDL_RenderClear(renderer);
+        Uint32 frame_ms = SDL_GetTicks() - frame0;
+        if (frame_ms < 1000 / FPS) SDL_Delay(1000 / FPS - frame_ms);
     }   
 
+    ai_turn.cancel();
+    ai_turn.play();
+
+#if USE_MCTS
+    MCTS::stop_pondering();
+#else
+    Minimax::stop_pondering();
+#endif
     SDL_DestroyTexture(hexgrid_tex);
     SDL_FreeSurface(hexgrid_img);
     SDL_DestroyRenderer(renderer);
@@ -0,0 +1,188 @@
+// Headless move generation benchmark and regression check.
+// Usage: perft [positions file] [max depth]
+// Each line of the positions file is "name | plays | count at depth 1, 2, ...":
+//   +A14,15       put an Ant on (14,15)
+//   B14,15-15,14  move the Beetle on top of (14,15) to (15,14), on top if occupied
+// Plays alternate starting with White, from the position built by Game(Piece::Spider).
+// Pieces: A Ant, Q Bee, B Beetle, G Grasshopper, S Spider.
+
+#include "Hive.h"
+#include "AI.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+using namespace Hive;
+using namespace AI;
+
+typedef chrono::steady_clock Clock;
+
+const string PIECE_CHARS = "AQBGS";
+const array<string,NPIECETYPES> PIECE_NAMES = {{ "Ant", "Bee", "Beetle", "Grasshopper", "Spider" }};
+
+double seconds_since(Clock::time_point t0)
+{
+	return chrono::duration<double>(Clock::now() - t0).count();
+}
+
+bool parse_play(Game& game, const string& s, Play& play)
+{
+	int x, y, x2, y2;
+	char piece_char, sep;
+	istringstream in(s);
+	if (s.size() > 1 && s[0] == '+') {
+		in >> sep >> piece_char >> x >> sep >> y;
+		size_t piece = PIECE_CHARS.find(piece_char);
+		if (!in || piece == string::npos) return false;
+		play = play_put(Hex(0, x, y), (Piece)piece);
+		return true;
+	}
+	in >> piece_char >> x >> sep >> y >> sep >> x2 >> sep >> y2;
+	size_t piece = PIECE_CHARS.find(piece_char);
+	if (!in || piece == string::npos || game.is_outside(Hex(0, x, y)) || game.is_outside(Hex(0, x2, y2))) return false;
+	Hex h = game.grid[x][y][1].piece != Piece::NoPiece ? game.grid[x][y][1] : game.grid[x][y][0];
+	if (h.piece != (Piece)piece) return false;
+	int layer = game.grid[x2][y2][0].piece != Piece::NoPiece ? 1 : 0;
+	play = play_move(h, Hex(layer, x2, y2), (Piece)piece);
+	return true;
+}
+
+bool is_legal(Game& game, Play play, Color color)
+{
+	MoveList plays;
+	gen_plays(game, color, plays);
+	for (Play p : plays) {
+		if (p == play) return true;
+	}
+	return false;
+}
+
+ull perft(Game& game, Color color, int depth)
+{
+	if (game.winner() != Color::NoColor) return 0;
+	MoveList plays;
+	gen_plays(game, color, plays);
+	if (depth == 1) return plays.size(); // bulk counting
+	ull nodes = 0;
+	for (Play play : plays) {
+		game.make_move(play, color);
+		nodes += perft(game, (Color)!color, depth - 1);
+		game.unmake_move();
+	}
+	return nodes;
+}
+
+// Times each generator at the nodes where perft(depth) does its bulk counting.
+// index NPIECETYPES is the placement generator.
+void time_generators(Game& game, Color color, int depth, array<double,NPIECETYPES+1>& secs,
+	array<ull,NPIECETYPES+1>& moves)
+{
+	if (game.winner() != Color::NoColor) return;
+	if (depth == 1) {
+		Clock::time_point t0 = Clock::now();
+		Bitboard spawns = game.spawn_cells(color);
+		secs[NPIECETYPES] += seconds_since(t0);
+		moves[NPIECETYPES] += spawns.count();
+
+		HexList targets;
+		for (Piece piece : PIECES) {
+			t0 = Clock::now();
+			for (Hex h : game.positions[color][piece]) {
+				if (game.is_locked(h)) continue;
+				targets.clear();
+				game.valid_moves(h, targets);
+				moves[piece] += targets.size();
+			}
+			secs[piece] += seconds_since(t0);
+		}
+		return;
+	}
+	MoveList plays;
+	gen_plays(game, color, plays);
+	for (Play play : plays) {
+		game.make_move(play, color);
+		time_generators(game, (Color)!color, depth - 1, secs, moves);
+		game.unmake_move();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	srand(0);
+	precompute_global_variables(); // NEVER remove this
+
+	string path = argc > 1 ? argv[1] : "perft.txt";
+	int max_depth = argc > 2 ? atoi(argv[2]) : 99;
+	ifstream file(path.c_str());
+	if (!file) {
+		cerr << "Cannot open " << path << endl;
+		return 1;
+	}
+
+	int failures = 0;
+	ull total_nodes = 0;
+	double total_secs = 0;
+	array<double,NPIECETYPES+1> gen_secs = {};
+	array<ull,NPIECETYPES+1> gen_moves = {};
+	string line;
+	while (getline(file, line)) {
+		if (line.empty() || line[0] == '#') continue;
+		size_t bar1 = line.find('|'), bar2 = line.rfind('|');
+		if (bar1 == string::npos || bar1 == bar2) {
+			cerr << "Malformed line: " << line << endl;
+			return 1;
+		}
+		string name = line.substr(0, bar1);
+		name.erase(name.find_last_not_of(' ') + 1);
+
+		Game game(Piece::Spider);
+		Color color = Color::White;
+		istringstream plays(line.substr(bar1 + 1, bar2 - bar1 - 1));
+		string token;
+		bool ok = true;
+		while (ok && plays >> token) {
+			Play play;
+			ok = parse_play(game, token, play) && is_legal(game, play, color);
+			if (!ok) cerr << name << ": illegal play " << token << endl;
+			else {
+				game.make_move(play, color);
+				color = (Color)!color;
+			}
+		}
+		if (!ok) {
+			++failures;
+			continue;
+		}
+
+		istringstream counts(line.substr(bar2 + 1));
+		vector<ull> expected;
+		ull count;
+		while ((int)expected.size() < max_depth && counts >> count) expected.push_back(count);
+		for (int depth = 1; depth <= (int)expected.size(); ++depth) {
+			Clock::time_point t0 = Clock::now();
+			ull nodes = perft(game, color, depth);
+			double secs = seconds_since(t0);
+			total_nodes += nodes;
+			total_secs += secs;
+			bool match = nodes == expected[depth-1];
+			if (!match) ++failures;
+			cout << name << " depth " << depth << ": " << nodes;
+			if (match) cout << " ok";
+			else cout << " MISMATCH, expected " << expected[depth-1];
+			cout << "  " << (ull)(nodes / max(secs, 1e-9)) << " nodes/s" << endl;
+		}
+		if (!expected.empty()) time_generators(game, color, expected.size(), gen_secs, gen_moves);
+	}
+
+	cout << endl << "Total: " << total_nodes << " nodes in " << total_secs << " s, "
+		<< (ull)(total_nodes / max(total_secs, 1e-9)) << " nodes/s" << endl;
+	cout << "Generators at the leaf parents of the deepest searches:" << endl;
+	for (int i = 0; i <= NPIECETYPES; ++i) {
+		cout << "  " << (i < NPIECETYPES ? PIECE_NAMES[i] : string("Placement")) << ": " << gen_moves[i] << " moves in "
+			<< gen_secs[i] << " s, " << (ull)(gen_moves[i] / max(gen_secs[i], 1e-9)) << " moves/s" << endl;
+	}
+	cout << (failures ? "FAILED: " + to_string(failures) + " mismatches" : string("All counts match")) << endl;
+	return failures ? 1 : 0;
+}
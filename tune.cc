@@ -0,0 +1,220 @@
+// Texel-style tuning of the evaluation weights from recorded games.
+// Usage:
+//   tune selfplay <games> <ms per move> <corpus file>       appends Minimax self-play games
+//   tune fit <corpus file> <weights file> [epochs] [initial weights file]
+// Each line of a corpus is a UHP GameString of a finished game, such as
+// "Base;WhiteWins;Black[12];wS1;bG1 -wS1;...". Every position after the opening is labelled
+// with the result of its game, and the weights are fitted so that sigmoid(K * evaluation)
+// predicts it: the logistic loss is minimized by full-batch gradient descent (Adam), the
+// gradient split over AI::threads. The evaluation is linear, so the features of every
+// position are computed once and each epoch is a pass over small integer vectors.
+
+#include "UHP.h"
+#include <fstream>
+
+using namespace std;
+using namespace Hive;
+using namespace AI;
+
+const int OPENING_PLIES = 6; // not labelled, too far from the result
+const int MAX_PLIES = 200; // self-play games still on after this are adjudicated a draw
+const int RANDOM_PLIES = 4; // self-play openings, so that the games differ
+const ld LEARNING_RATE = 0.5; // in weight units per step
+const ld BETA1 = 0.9, BETA2 = 0.999; // Adam
+
+struct Sample {
+	Features f; // White's minus Black's
+	float result; // for White: 1 win, 0.5 draw, 0 loss
+};
+
+typedef array<ld,NFEATURES> Vector;
+
+// Appends the positions of the finished games of the corpus, false if it cannot be read
+bool load_corpus(const string& path, V<Sample>& samples)
+{
+	ifstream in(path.c_str());
+	if (!in) return false;
+	int games = 0, skipped = 0;
+	for (string line; getline(in, line); ) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line.empty()) continue;
+		V<string> fields;
+		istringstream game_str(line);
+		for (string field; getline(game_str, field, ';'); ) fields.push_back(field);
+		float result;
+		if (fields.size() < 3 || fields[0] != "Base") result = -1;
+		else if (fields[1] == "WhiteWins") result = 1;
+		else if (fields[1] == "BlackWins") result = 0;
+		else if (fields[1] == "Draw") result = 0.5;
+		else result = -1; // not finished
+		if (result < 0) {
+			++skipped;
+			continue;
+		}
+
+		UHP::Engine engine;
+		V<Sample> game_samples;
+		string error;
+		for (size_t i = 3; i < fields.size(); ++i) {
+			if (!engine.play(fields[i], error)) break;
+			if ((int)i - 2 < OPENING_PLIES || engine.game.winner() != Color::NoColor) continue;
+			Sample sample;
+			features(engine.game, Color::White, sample.f);
+			sample.result = result;
+			game_samples.push_back(sample);
+		}
+		if (!error.empty()) {
+			cerr << "skipped game " << games + skipped + 1 << ": " << error << endl;
+			++skipped;
+			continue;
+		}
+		samples.insert(samples.end(), game_samples.begin(), game_samples.end());
+		++games;
+	}
+	cerr << games << " games, " << samples.size() << " positions, " << skipped << " lines skipped" << endl;
+	return true;
+}
+
+inline ld sigmoid(ld x)
+{
+	return 1 / (1 + exp(-x));
+}
+
+// Mean logistic loss of w with scale K, and its gradient in grad if grad != NULL
+ld loss(const V<Sample>& samples, const Vector& w, ld K, Vector* grad)
+{
+	int n = samples.size(), nthreads = max(1, min(threads, n / 1024 + 1));
+	V<ld> losses(nthreads, 0);
+	V<Vector> grads(nthreads);
+	V<thread> workers;
+	for (int t = 0; t < nthreads; ++t) {
+		workers.push_back(thread([&samples, &w, &losses, &grads, K, n, nthreads, t, grad]() {
+			Vector& g = grads[t];
+			g.fill(0);
+			for (int i = (ll)n * t / nthreads; i < (ll)n * (t + 1) / nthreads; ++i) {
+				const Sample& s = samples[i];
+				ld score = 0;
+				for (int j = 0; j < NFEATURES; ++j) score += w[j] * s.f[j];
+				ld p = min(max(sigmoid(K * score), (ld)1e-12), 1 - (ld)1e-12);
+				losses[t] -= s.result * log(p) + (1 - s.result) * log(1 - p);
+				if (grad == NULL) continue;
+				for (int j = 0; j < NFEATURES; ++j) g[j] += (p - s.result) * K * s.f[j];
+			}
+		}));
+	}
+	for (thread& worker : workers) worker.join();
+	ld total = 0;
+	if (grad != NULL) grad->fill(0);
+	for (int t = 0; t < nthreads; ++t) {
+		total += losses[t];
+		for (int j = 0; grad != NULL && j < NFEATURES; ++j) (*grad)[j] += grads[t][j] / n;
+	}
+	return total / n;
+}
+
+// The scale that best fits w as it is, by golden-section search on log K
+ld fit_scale(const V<Sample>& samples, const Vector& w)
+{
+	const ld phi = (sqrt(5.0L) - 1) / 2;
+	ld lo = log(1e-5L), hi = log(1.0L);
+	for (int i = 0; i < 40; ++i) {
+		ld a = hi - phi * (hi - lo), b = lo + phi * (hi - lo);
+		if (loss(samples, w, exp(a), NULL) < loss(samples, w, exp(b), NULL)) hi = b;
+		else lo = a;
+	}
+	return exp((lo + hi) / 2);
+}
+
+int fit(const string& corpus, const string& out, int epochs, const string& initial)
+{
+	if (!initial.empty() && !load_weights(initial)) {
+		cerr << "unable to load weights from " << initial << endl;
+		return 1;
+	}
+	V<Sample> samples;
+	if (!load_corpus(corpus, samples)) {
+		cerr << "unable to read " << corpus << endl;
+		return 1;
+	}
+	if (samples.empty()) {
+		cerr << "no positions to fit" << endl;
+		return 1;
+	}
+
+	Vector w, m, v, grad;
+	for (int j = 0; j < NFEATURES; ++j) w[j] = weights[j];
+	m.fill(0), v.fill(0);
+	ld K = fit_scale(samples, w); // fixed from here on, the weights keep the scale of the evaluation
+	cerr << "K = " << K << ", loss " << loss(samples, w, K, NULL) << endl;
+
+	time_point time0;
+	reset_clock(time0);
+	for (int epoch = 1; epoch <= epochs; ++epoch) {
+		ld l = loss(samples, w, K, &grad);
+		for (int j = 0; j < NFEATURES; ++j) {
+			m[j] = BETA1 * m[j] + (1 - BETA1) * grad[j];
+			v[j] = BETA2 * v[j] + (1 - BETA2) * grad[j] * grad[j];
+			ld m_hat = m[j] / (1 - pow(BETA1, epoch)), v_hat = v[j] / (1 - pow(BETA2, epoch));
+			w[j] -= LEARNING_RATE * m_hat / (sqrt(v_hat) + 1e-12);
+		}
+		if (epoch % 100 == 0 || epoch == epochs) cerr << "epoch " << epoch << ", loss " << l << ", " << delta_time(time0) << " ms" << endl;
+	}
+
+	Weights tuned;
+	for (int j = 0; j < NFEATURES; ++j) tuned[j] = llround(w[j]);
+	for (int j = 0; j < NFEATURES; ++j) cerr << FEATURE_NAMES[j] << " " << weights[j] << " -> " << tuned[j] << endl;
+	if (!save_weights(out, tuned)) {
+		cerr << "unable to write " << out << endl;
+		return 1;
+	}
+	return 0;
+}
+
+int selfplay(int games, int ms, const string& corpus)
+{
+	ofstream out(corpus.c_str(), ios::app);
+	if (!out) {
+		cerr << "unable to write " << corpus << endl;
+		return 1;
+	}
+	for (int g = 0; g < games; ++g) {
+		UHP::Engine engine;
+		Minimax::TT.clear();
+		string error;
+		for (int ply = 0; ply < MAX_PLIES; ++ply) {
+			string state = engine.game_state();
+			if (state != "NotStarted" && state != "InProgress") break;
+			Play play;
+			if (ply < RANDOM_PLIES) {
+				MoveList plays;
+				gen_plays(engine.game, engine.turn, plays); // shuffled
+				play = (plays.empty() ? NOPLAY : plays[0]);
+			}
+			else {
+				play = Minimax::search(engine.game, engine.turn, ms);
+			}
+			engine.play(play == NOPLAY ? "pass" : engine.move_string(play), error);
+		}
+		string state = engine.game_state(), game_string = engine.game_string();
+		if (state == "InProgress") {
+			game_string.replace(game_string.find(state), state.size(), "Draw");
+			state = "Draw";
+		}
+		cerr << "game " << g + 1 << ": " << state << " in " << engine.history.size() << " plies" << endl;
+		out << game_string << endl;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	srand(time(0));
+	precompute_global_variables(); // NEVER remove this
+
+	string mode = argc > 1 ? argv[1] : "";
+	if (mode == "selfplay" && argc == 5) return selfplay(atoi(argv[2]), atoi(argv[3]), argv[4]);
+	if (mode == "fit" && argc >= 4 && argc <= 6) return fit(argv[2], argv[3], argc > 4 ? atoi(argv[4]) : 2000, argc > 5 ? argv[5] : "");
+	cerr << "Usage: tune selfplay <games> <ms per move> <corpus file>" << endl
+		<< "       tune fit <corpus file> <weights file> [epochs] [initial weights file]" << endl;
+	return 1;
+}